@@ -4,34 +4,24 @@
 #ifndef FILECONFIG_H
 #define FILECONFIG_H
 
-// File counts
+// File list sizes (the files themselves are listed in assets.pak)
 #define MAX_SEQ_FILES 2
 #define MAX_VH_FILES 1
 
-// Extern declarations for SEQ files
-extern u_char _binary_SEQ_MOUSE_seq_start[];
-extern u_char _binary_SEQ_scale_seq_start[];
+// Background image (16-bit TIM recommended, up to 320x240)
+#define HAS_BACKGROUND_IMAGE 0
 
-// Extern declarations for VH files
-extern u_char _binary_SOUNDBANK_VH_piano_vh_start[];
+// Shared sample pool (vbpool.h has the VAG offsets of each bank)
+#define VB_POOL 0
 
-// Extern declarations for VB files
-extern u_char _binary_SOUNDBANK_VB_piano_vb_start[];
+// SEQs and samples read from DISC.PAK on the CD
+#define CD_ASSETS 0
 
-// SEQ file initialization array
-#define SEQ_FILES_INIT { \
-    {"MOUSE.seq", _binary_SEQ_MOUSE_seq_start, 0, 0}, \
-    {"scale.seq", _binary_SEQ_scale_seq_start, 0, 0}, \
-}
+// SEQs and samples in assets.pak may be LZ-compressed
+#define LZ_ASSETS 0
 
-// VH file initialization array
-#define VH_FILES_INIT { \
-    {"piano.vh", _binary_SOUNDBANK_VH_piano_vh_start, 0, 1}, \
-}
-
-// VB file initialization array
-#define VB_FILES_INIT { \
-    _binary_SOUNDBANK_VB_piano_vb_start, \
-}
+// Asset archive
+extern u_char _binary_assets_pak_start[];
+#define ASSET_PAK _binary_assets_pak_start
 
 #endif // FILECONFIG_H
@@ -0,0 +1,43 @@
+// Serial hot-load protocol (player receive mode <-> tools/hotload)
+// The host sends one file at a time: a HotHeader, then the file in chunks of
+// up to HOT_CHUNK bytes, each answered by the player before the next is sent
+// (stop and wait, so the player's receive ring never overflows).
+//
+// Chunk: u16 index, u16 length, length bytes, u32 pakHash of all of the above.
+// Replies are a single byte:
+//   header:     HOT_ACK, HOT_NAK (damaged, send again) or HOT_REFUSE (no room)
+//   chunk:      HOT_ACK, HOT_NAK (damaged or lost, send again)
+//   last chunk: HOT_DONE (file hash matches, file registered) or HOT_REFUSE
+// A chunk the player already has (its ACK was lost) is answered HOT_ACK again.
+// All fields are little-endian, 8N1 at HOT_BAUD.
+//
+// Shared by the player and the host tools, so only plain C and sys/types.h
+
+#ifndef HOTLOAD_H
+#define HOTLOAD_H
+
+#include "pak.h"
+
+#define HOT_MAGIC 0x544F4853     // "SHOT"
+#define HOT_BAUD 115200
+#define HOT_CHUNK 1024           // Largest chunk payload
+#define HOT_CHUNK_HEAD 4         // index, length
+#define HOT_CHUNK_TAIL 4         // hash
+
+// Replies
+#define HOT_ACK 0x06
+#define HOT_NAK 0x15
+#define HOT_REFUSE 0x18
+#define HOT_DONE 0x04
+
+typedef struct {
+    u_int magic;
+    u_int size;              // File size
+    u_int hash;              // pakHash of the whole file
+    u_char type;             // PAK_SEQ, PAK_VH or PAK_VB
+    u_char reserved[3];
+    char name[PAK_NAME_SIZE];  // File name without directory
+    u_int check;             // pakHash of the fields above
+} HotHeader;
+
+#endif // HOTLOAD_H
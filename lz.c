@@ -0,0 +1,58 @@
+// LZ block decompression (see lz.h)
+// Written for the R3000: no multiplies, no unaligned loads, one pass over the
+// input and the only branch per copied byte is the loop itself
+
+#include <sys/types.h>
+#include "lz.h"
+
+int lzDecompress(const u_char* src, u_int src_size, u_char* dst, u_int dst_size)
+{
+    const u_char* in = src;
+    const u_char* in_end = src + src_size;
+    u_char* out = dst;
+    u_char* out_end = dst + dst_size;
+    const u_char* match;
+    u_int token, length, extra;
+    
+    while (in < in_end) {
+        token = *in++;
+        
+        // Literals
+        length = token >> 4;
+        if (length == 15) {
+            do {
+                if (in >= in_end) return -1;
+                extra = *in++;
+                length += extra;
+            } while (extra == 255);
+        }
+        if (length > (u_int)(in_end - in) || length > (u_int)(out_end - out)) return -1;
+        while (length--) {
+            *out++ = *in++;
+        }
+        if (in >= in_end) break;  // Last sequence
+        
+        // Match
+        if (in_end - in < 2) return -1;
+        match = out - (in[0] | (in[1] << 8));
+        in += 2;
+        if (match < dst || match == out) return -1;
+        
+        length = (token & 15) + LZ_MIN_MATCH;
+        if ((token & 15) == 15) {
+            do {
+                if (in >= in_end) return -1;
+                extra = *in++;
+                length += extra;
+            } while (extra == 255);
+        }
+        if (length > (u_int)(out_end - out)) return -1;
+        
+        // Byte copy, matches may overlap their own output
+        while (length--) {
+            *out++ = *match++;
+        }
+    }
+    
+    return (int)(out - dst);
+}
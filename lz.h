@@ -0,0 +1,19 @@
+// LZ block decompression
+// LZ4-style sequences: a token byte (literal count in the high nibble, match
+// length - 4 in the low nibble, 15 = more length bytes follow, each adding up
+// to 255), the literals, then a 16-bit little-endian match offset. The last
+// sequence of a block has literals only. Blocks are independent, so an asset
+// can be expanded one block at a time into a small buffer.
+//
+// Shared by the player and the host tools, so only plain C and sys/types.h
+
+#ifndef LZ_H
+#define LZ_H
+
+#define LZ_MIN_MATCH 4
+
+// Expand src into dst. Returns the bytes written, or -1 if src is damaged or
+// would write past dst_size
+int lzDecompress(const u_char* src, u_int src_size, u_char* dst, u_int dst_size);
+
+#endif // LZ_H
@@ -0,0 +1,82 @@
+// Asset archive (see pak.h)
+
+#include <sys/types.h>
+#include "pak.h"
+#include "lz.h"
+
+u_int pakHash(const u_char* data, u_int size, u_int hash)
+{
+    u_int i;
+    
+    for (i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 0x01000193;
+    }
+    return hash;
+}
+
+int pakCount(const u_char* data)
+{
+    const PakHeader* header = (const PakHeader*)data;
+    
+    if (header->magic != PAK_MAGIC || header->version != PAK_VERSION) {
+        return -1;
+    }
+    return (int)header->count;
+}
+
+PakEntry* pakEntry(const u_char* data, int i)
+{
+    return (PakEntry*)(data + sizeof(PakHeader)) + i;
+}
+
+PakEntry* pakFind(const u_char* data, const char* name, int type)
+{
+    PakEntry* entry;
+    int count = pakCount(data);
+    int i, c;
+    
+    for (i = 0; i < count; i++) {
+        entry = pakEntry(data, i);
+        if (entry->type != type) continue;
+        
+        // Names are NUL padded to PAK_NAME_SIZE
+        for (c = 0; c < PAK_NAME_SIZE && entry->name[c] == name[c] && name[c]; c++);
+        if (c == PAK_NAME_SIZE || entry->name[c] == name[c]) return entry;
+    }
+    return 0;
+}
+
+int pakUnpackBlock(const u_char** cursor, u_char* out)
+{
+    const u_char* block = *cursor;
+    u_int header = block[0] | (block[1] << 8);
+    u_int length = header & ~PAK_BLOCK_RAW;
+    u_int i;
+    
+    *cursor = block + 2 + length;
+    if (!(header & PAK_BLOCK_RAW)) {
+        return lzDecompress(block + 2, length, out, PAK_BLOCK);
+    }
+    
+    if (length > PAK_BLOCK) return -1;
+    for (i = 0; i < length; i++) {
+        out[i] = block[2 + i];
+    }
+    return (int)length;
+}
+
+int pakUnpack(const u_char* stored, u_int size, u_char* out)
+{
+    u_int done = 0;
+    int length;
+    
+    // Every block but the last expands to exactly PAK_BLOCK bytes
+    while (done < size) {
+        length = pakUnpackBlock(&stored, out + done);
+        if (length <= 0 || done + length > size || (length != PAK_BLOCK && done + length != size)) {
+            return -1;
+        }
+        done += length;
+    }
+    return (int)size;
+}
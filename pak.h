@@ -0,0 +1,82 @@
+// Asset archive
+// One file (assets.pak) holds every SEQ, VH, VB and the optional background
+// TIM, so the exe links a single binary blob instead of a symbol per file.
+// The header is followed by an index of PakEntry, then the file data, each
+// file starting on a PAK_ALIGN boundary. All fields are little-endian.
+//
+// A disc archive (DISC.PAK, CD_ASSETS) starts every file on a CD sector so the
+// player can read one straight into a buffer.
+//
+// SEQ, VB and pool entries may be stored compressed (PAK_FLAG_LZ): a run of
+// blocks, each a 16-bit length (PAK_BLOCK_RAW set = stored as is) and the LZ
+// data of PAK_BLOCK bytes of the file (less for the last one). They are read
+// a block at a time, so a VB never needs a RAM buffer of its full size.
+//
+// Shared by the player and the host tools, so only plain C and sys/types.h
+
+#ifndef PAK_H
+#define PAK_H
+
+#define PAK_MAGIC 0x4B415053     // "SPAK"
+#define PAK_VERSION 2
+#define PAK_ALIGN 16             // Enough for VabHdr, TIM and SPU DMA sources
+#define PAK_SECTOR 2048          // Alignment of a disc archive (pack -s), read with CdRead
+#define PAK_NAME_SIZE 32
+#define PAK_BLOCK 16384          // File bytes per compressed block
+#define PAK_BLOCK_RAW 0x8000     // Block length flag: block is not compressed
+
+// Entry flags
+#define PAK_FLAG_LZ 1
+
+// Entry types
+#define PAK_SEQ 0
+#define PAK_VH 1
+#define PAK_VB 2
+#define PAK_TIM 3
+#define PAK_POOL 4               // Deduplicated VAGs (VB_POOL)
+
+#define PAK_HASH_INIT 0x811C9DC5
+
+typedef struct {
+    u_int magic;
+    u_int version;
+    u_int count;             // Index entries
+    u_int size;              // Whole archive in bytes
+} PakHeader;
+
+// Index entry (56 bytes)
+typedef struct {
+    char name[PAK_NAME_SIZE];  // File name without directory
+    u_int offset;            // From the start of the archive
+    u_int size;              // File size
+    u_int packed;            // Bytes stored in the archive (size unless PAK_FLAG_LZ)
+    u_int hash;              // pakHash of the stored bytes
+    u_short programs;        // VH: programs (ps)
+    u_short tones;           // VH: tones (ts)
+    u_char type;             // PAK_*
+    u_char flags;            // PAK_FLAG_*
+    u_char reserved[2];
+} PakEntry;
+
+// FNV-1a, continued from hash (PAK_HASH_INIT for a new one)
+u_int pakHash(const u_char* data, u_int size, u_int hash);
+
+// Number of entries, or -1 if data is not an archive of this version
+int pakCount(const u_char* data);
+
+// Index entry i (no bounds check, see pakCount)
+PakEntry* pakEntry(const u_char* data, int i);
+
+// First entry with this name and type, 0 if there is none
+PakEntry* pakFind(const u_char* data, const char* name, int type);
+
+// Expand the PAK_FLAG_LZ block at *cursor (the entry's data for the first one)
+// into out, which has room for PAK_BLOCK bytes, and move *cursor past it.
+// Returns the bytes written, -1 if the block is damaged
+int pakUnpackBlock(const u_char** cursor, u_char* out);
+
+// Expand a whole PAK_FLAG_LZ file of size bytes from its stored data into
+// out. Returns size, -1 if a block is damaged
+int pakUnpack(const u_char* stored, u_int size, u_char* out);
+
+#endif // PAK_H
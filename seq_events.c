@@ -0,0 +1,325 @@
+// SEQ event decoding (see seq_events.h)
+
+#include <sys/types.h>
+#include "seq_events.h"
+
+static int seqAddEvent(SeqSong* song, int max_events, u_int tick, int type, int channel, int data1, int data2)
+{
+    SeqEvent* ev;
+    
+    if (song->num_events >= max_events) {
+        return -1;
+    }
+    
+    ev = &song->events[song->num_events++];
+    ev->tick = tick;
+    ev->type = (u_char)type;
+    ev->channel = (u_char)channel;
+    ev->data1 = (u_char)data1;
+    ev->data2 = (u_char)data2;
+    return 0;
+}
+
+int seqDecode(const u_char* data, u_int max_size, SeqEvent* events, int max_events, SeqSong* song)
+{
+    u_int pos = SEQ_HEADER_SIZE;
+    u_int tick = 0;
+    u_int delta;
+    int status = 0;
+    int channel, data1, data2;
+    int loop_end = -1;
+    u_char byte;
+    
+    // Header: "pQES", version (4), resolution (2), tempo (3), rhythm (2), all big-endian
+    if (max_size && max_size < SEQ_HEADER_SIZE) {
+        return -1;
+    }
+    if (data[0] != 'p' || data[1] != 'Q' || data[2] != 'E' || data[3] != 'S') {
+        return -1;
+    }
+    
+    song->events = events;
+    song->num_events = 0;
+    song->resolution = (data[8] << 8) | data[9];
+    song->tempo = (data[10] << 16) | (data[11] << 8) | data[12];
+    song->rhythm_num = data[13];
+    song->rhythm_den = data[14];
+    song->loop_start = 0;
+    song->loop_start_tick = 0;
+    
+    if (song->resolution == 0 || song->tempo == 0) {
+        return -1;
+    }
+    
+// Bounds check for every byte read past the header
+#define SEQ_NEED(n) if (max_size && pos + (n) > max_size) return -1
+    
+    while (1) {
+        // Variable-length delta time
+        delta = 0;
+        do {
+            SEQ_NEED(1);
+            byte = data[pos++];
+            delta = (delta << 7) | (byte & 0x7F);
+        } while (byte & 0x80);
+        tick += delta;
+        
+        // Status byte or running status
+        SEQ_NEED(1);
+        if (data[pos] & 0x80) {
+            byte = data[pos++];
+            if (byte == 0xFF) {
+                // Meta event (no length byte in SEQ files), keeps running status
+                SEQ_NEED(1);
+                byte = data[pos++];
+                if (byte == 0x51) {
+                    SEQ_NEED(3);
+                    // A tempo of 0 would divide by zero in the tick and the tempo map
+                    if ((data[pos] | data[pos + 1] | data[pos + 2]) == 0) {
+                        return -1;
+                    }
+                    if (seqAddEvent(song, max_events, tick, SEQ_EV_TEMPO,
+                                    data[pos], data[pos + 1], data[pos + 2]) < 0) {
+                        return -1;
+                    }
+                    pos += 3;
+                    continue;
+                }
+                // 0x2F end of track, anything else is unsupported and ends the song
+                pos++;
+                break;
+            }
+            if (byte >= 0xF0) {
+                // SysEx is not used by libsnd sequences
+                break;
+            }
+            status = byte;
+        } else if (status == 0) {
+            return -1;
+        }
+        
+        channel = status & 0x0F;
+        switch (status & 0xF0) {
+            case 0x80:
+            case 0x90:
+                SEQ_NEED(2);
+                data1 = data[pos++];
+                data2 = data[pos++];
+                if ((status & 0xF0) == 0x90 && data2 > 0) {
+                    if (seqAddEvent(song, max_events, tick, SEQ_EV_NOTE_ON, channel, data1, data2) < 0) return -1;
+                } else {
+                    if (seqAddEvent(song, max_events, tick, SEQ_EV_NOTE_OFF, channel, data1, 0) < 0) return -1;
+                }
+                break;
+                
+            case 0xB0:
+                SEQ_NEED(2);
+                data1 = data[pos++];
+                data2 = data[pos++];
+                if (data1 == SEQ_CC_NRPN_MSB && data2 == SEQ_NRPN_LOOP_START) {
+                    song->loop_start = song->num_events;
+                    song->loop_start_tick = tick;
+                } else if (data1 == SEQ_CC_NRPN_MSB && data2 == SEQ_NRPN_LOOP_END) {
+                    if (loop_end < 0) {
+                        loop_end = song->num_events;
+                        song->loop_end_tick = tick;
+                    }
+                } else {
+                    if (seqAddEvent(song, max_events, tick, SEQ_EV_CONTROL, channel, data1, data2) < 0) return -1;
+                }
+                break;
+                
+            case 0xC0:
+                SEQ_NEED(1);
+                data1 = data[pos++];
+                if (seqAddEvent(song, max_events, tick, SEQ_EV_PROGRAM, channel, data1, 0) < 0) return -1;
+                break;
+                
+            case 0xE0:
+                SEQ_NEED(2);
+                data1 = data[pos++];  // LSB, ignored by libsnd
+                data2 = data[pos++];  // MSB
+                if (seqAddEvent(song, max_events, tick, SEQ_EV_PITCH_BEND, channel, data2, data1) < 0) return -1;
+                break;
+                
+            case 0xA0:
+                // Polyphonic aftertouch, not used
+                SEQ_NEED(2);
+                pos += 2;
+                break;
+                
+            case 0xD0:
+                // Channel pressure, not used
+                SEQ_NEED(1);
+                pos += 1;
+                break;
+        }
+    }
+    
+#undef SEQ_NEED
+    
+    if (seqAddEvent(song, max_events, tick, SEQ_EV_END, 0, 0, 0) < 0) {
+        return -1;
+    }
+    
+    song->end_tick = tick;
+    if (loop_end < 0) {
+        loop_end = song->num_events - 1;
+        song->loop_end_tick = tick;
+    }
+    song->loop_end = loop_end;
+    song->size = pos;
+    return song->num_events;
+}
+
+u_int seqBarTicks(const SeqSong* song)
+{
+    // Denominator is stored as a power of two (2 = quarter note)
+    u_int bar = (song->resolution * 4 * song->rhythm_num) >> song->rhythm_den;
+    return bar ? bar : song->resolution * 4;
+}
+
+void seqResetChannels(SeqChannelState* chan)
+{
+    int i;
+    
+    for (i = 0; i < 16; i++) {
+        chan->program[i] = 0;
+        chan->volume[i] = 127;
+        chan->pan[i] = 64;
+        chan->bend[i] = 64;
+    }
+}
+
+void seqApplyEvent(SeqChannelState* chan, u_int* tempo, const SeqEvent* ev)
+{
+    switch (ev->type) {
+        case SEQ_EV_PROGRAM:
+            chan->program[ev->channel] = ev->data1 & 0x7F;
+            break;
+        case SEQ_EV_CONTROL:
+            if (ev->data1 == SEQ_CC_VOLUME) chan->volume[ev->channel] = ev->data2;
+            if (ev->data1 == SEQ_CC_PAN) chan->pan[ev->channel] = ev->data2;
+            break;
+        case SEQ_EV_PITCH_BEND:
+            chan->bend[ev->channel] = ev->data1;
+            break;
+        case SEQ_EV_TEMPO:
+            *tempo = SEQ_EV_TEMPO_VALUE(ev);
+            break;
+    }
+}
+
+int seqBuildCheckpoints(const SeqSong* song, u_int interval, SeqCheckpoint* checkpoints,
+                        int max_checkpoints, u_int* used_interval)
+{
+    SeqChannelState chan;
+    u_int tempo = song->tempo;
+    u_int next_tick = 0;
+    int count = 0;
+    int i = 0;
+    
+    if (interval == 0 || max_checkpoints <= 0) return 0;
+    
+    // Keep the index bounded for very long songs
+    while (song->end_tick / interval >= (u_int)max_checkpoints) {
+        interval <<= 1;
+    }
+    *used_interval = interval;
+    
+    seqResetChannels(&chan);
+    while (next_tick <= song->end_tick) {
+        // Everything before next_tick is part of the snapshot
+        while (i < song->num_events && song->events[i].tick < next_tick) {
+            seqApplyEvent(&chan, &tempo, &song->events[i]);
+            i++;
+        }
+        
+        checkpoints[count].tick = next_tick;
+        checkpoints[count].cursor = i;
+        checkpoints[count].tempo = tempo;
+        checkpoints[count].chan = chan;
+        count++;
+        next_tick += interval;
+    }
+    
+    return count;
+}
+
+int seqBuildTempoMap(const SeqSong* song, SeqTempoEntry* map, int max_entries)
+{
+    const SeqEvent* ev;
+    int count = 1;
+    int i;
+    
+    if (max_entries <= 0) return -1;
+    
+    map[0].tick = 0;
+    map[0].tempo = song->tempo;
+    map[0].time = 0;
+    
+    for (i = 0; i < song->num_events; i++) {
+        ev = &song->events[i];
+        if (ev->type != SEQ_EV_TEMPO) continue;
+        
+        // Several tempo events on one tick: the last one wins
+        if (ev->tick == map[count - 1].tick) {
+            map[count - 1].tempo = SEQ_EV_TEMPO_VALUE(ev);
+            continue;
+        }
+        if (count >= max_entries) return -1;
+        
+        map[count].tick = ev->tick;
+        map[count].tempo = SEQ_EV_TEMPO_VALUE(ev);
+        map[count].time = map[count - 1].time +
+                          (unsigned long long)(ev->tick - map[count - 1].tick) * map[count - 1].tempo;
+        count++;
+    }
+    
+    return count;
+}
+
+unsigned long long seqTickToTime(const SeqTempoEntry* map, int count, u_int tick)
+{
+    int lo = 0;
+    int hi = count - 1;
+    int mid;
+    
+    // Last entry starting at or before tick
+    while (lo < hi) {
+        mid = (lo + hi + 1) >> 1;
+        if (map[mid].tick <= tick) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    
+    return map[lo].time + (unsigned long long)(tick - map[lo].tick) * map[lo].tempo;
+}
+
+u_int seqTickToMs(const SeqSong* song, const SeqTempoEntry* map, int count, u_int tick)
+{
+    unsigned long long time = seqTickToTime(map, count, tick);
+    
+    return (u_int)(time / ((unsigned long long)song->resolution * 1000));
+}
+
+u_int seqTimeToTick(const SeqTempoEntry* map, int count, unsigned long long time)
+{
+    int lo = 0;
+    int hi = count - 1;
+    int mid;
+    
+    // Last entry starting at or before time
+    while (lo < hi) {
+        mid = (lo + hi + 1) >> 1;
+        if (map[mid].time <= time) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    
+    return map[lo].tick + (u_int)((time - map[lo].time) / map[lo].tempo);
+}
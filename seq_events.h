@@ -0,0 +1,115 @@
+// SEQ event decoding
+// Turns a libsnd sequence (.seq, "pQES") into a flat table of fixed-width
+// events once, so playback only has to walk a cursor and never parses
+// variable-length deltas or running status on the tick interrupt.
+//
+// Shared by the player and the host tools, so only plain C and sys/types.h
+
+#ifndef SEQ_EVENTS_H
+#define SEQ_EVENTS_H
+
+#define SEQ_HEADER_SIZE 15       // "pQES", version, resolution, tempo, rhythm
+
+// Event types
+#define SEQ_EV_NOTE_OFF 0
+#define SEQ_EV_NOTE_ON 1
+#define SEQ_EV_PROGRAM 2
+#define SEQ_EV_CONTROL 3
+#define SEQ_EV_PITCH_BEND 4
+#define SEQ_EV_TEMPO 5           // 24-bit usec per quarter note in channel/data1/data2
+#define SEQ_EV_END 6
+
+// MIDI controllers the player interprets
+#define SEQ_CC_VOLUME 7
+#define SEQ_CC_PAN 10
+#define SEQ_CC_NRPN_MSB 99       // libsnd loop markers: 20 = loop start, 30 = loop end
+#define SEQ_NRPN_LOOP_START 20
+#define SEQ_NRPN_LOOP_END 30
+
+// Decoded event (8 bytes)
+typedef struct {
+    u_int tick;          // Absolute tick from the start of the song
+    u_char type;         // SEQ_EV_*
+    u_char channel;      // MIDI channel (tempo: bits 23-16)
+    u_char data1;        // Note / program / controller / bend MSB (tempo: bits 15-8)
+    u_char data2;        // Velocity / value (tempo: bits 7-0)
+} SeqEvent;
+
+#define SEQ_EV_TEMPO_VALUE(ev) \
+    (((u_int)(ev)->channel << 16) | ((u_int)(ev)->data1 << 8) | (ev)->data2)
+
+// Decoded song
+typedef struct {
+    SeqEvent* events;
+    int num_events;          // Including the closing SEQ_EV_END
+    u_short resolution;      // Ticks per quarter note
+    u_int tempo;             // Initial usec per quarter note
+    u_char rhythm_num;       // Time signature numerator
+    u_char rhythm_den;       // Time signature denominator (power of two)
+    u_int end_tick;          // Tick of the end of track
+    int loop_start;          // Event index of the loop start (0 if no marker)
+    int loop_end;            // Event index of the loop end (SEQ_EV_END if no marker)
+    u_int loop_start_tick;   // Tick of the loop start marker (0 if no marker)
+    u_int loop_end_tick;     // Tick of the loop end marker (end_tick if no marker)
+    u_int size;              // Bytes read from the file
+} SeqSong;
+
+// Channel state that survives between notes (snapshotted for seeking)
+typedef struct {
+    u_char program[16];
+    u_char volume[16];
+    u_char pan[16];
+    u_char bend[16];         // Pitch bend MSB, 64 = center
+} SeqChannelState;
+
+// Controller-state checkpoint: state after every event before tick
+typedef struct {
+    u_int tick;
+    int cursor;              // First event at or after tick
+    u_int tempo;             // usec per quarter note in effect at tick
+    SeqChannelState chan;
+} SeqCheckpoint;
+
+// Tempo map entry. Song time is kept exact as usec * resolution so tick to
+// time conversion never accumulates rounding error
+typedef struct {
+    u_int tick;              // Tick where this tempo starts
+    u_int tempo;             // usec per quarter note
+    unsigned long long time; // Song time at tick in usec * resolution
+} SeqTempoEntry;
+
+// Decode a .seq file into events[] (max_size 0 = stop at end of track).
+// Returns the number of events written, or -1 if the data is not a valid
+// sequence or does not fit into max_events.
+int seqDecode(const u_char* data, u_int max_size, SeqEvent* events, int max_events, SeqSong* song);
+
+// Ticks in one bar of the song's time signature
+u_int seqBarTicks(const SeqSong* song);
+
+// Reset channel state to power-on defaults (program 0, volume 127, center pan and bend)
+void seqResetChannels(SeqChannelState* chan);
+
+// Apply a non-note event (program, controller, bend, tempo) to a channel state.
+// Notes and SEQ_EV_END are ignored
+void seqApplyEvent(SeqChannelState* chan, u_int* tempo, const SeqEvent* ev);
+
+// Snapshot channel state every interval ticks (interval is doubled until the
+// song fits into max_checkpoints). Returns the number of checkpoints and the
+// interval that was used
+int seqBuildCheckpoints(const SeqSong* song, u_int interval, SeqCheckpoint* checkpoints,
+                        int max_checkpoints, u_int* used_interval);
+
+// Build the tempo map from the header tempo and the tempo meta events.
+// Returns the number of entries, or -1 if the song has more than max_entries
+int seqBuildTempoMap(const SeqSong* song, SeqTempoEntry* map, int max_entries);
+
+// Song time at tick in usec * resolution (at the song's own tempo)
+unsigned long long seqTickToTime(const SeqTempoEntry* map, int count, u_int tick);
+
+// Tick at song time (usec * resolution), the inverse of seqTickToTime
+u_int seqTimeToTick(const SeqTempoEntry* map, int count, unsigned long long time);
+
+// Song time in milliseconds at tick (at the song's own tempo)
+u_int seqTickToMs(const SeqSong* song, const SeqTempoEntry* map, int count, u_int tick);
+
+#endif // SEQ_EVENTS_H
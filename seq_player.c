@@ -5,20 +5,151 @@
 // Uses libsnd for sequence/VAB playback
 
 #include <sys/types.h>
+#include <sys/file.h>
 #include <stdio.h>
+#include <string.h>
 #include <libgte.h>
 #include <libetc.h>
 #include <libgpu.h>
 #include <libsnd.h>
 #include <libspu.h>
+#include <libapi.h>
+#include "fileconfig.h"
+#if CD_ASSETS
+#include <libcd.h>
+#endif
 
 // Include auto-generated file configuration
-#include "fileconfig.h"
+#include "seq_events.h"
+#include "spu_env.h"
+#include "pak.h"
+#include "hotload.h"
+#if VB_POOL
+#include "vbpool.h"
+#endif
 
 #define VMODE 0                 // Video Mode : 0 : NTSC, 1: PAL
 #define SCREENXRES 320
 #define SCREENYRES 240
 
+// Sequencer clock
+// SEQ_TICK_RCNT 1: the sequencer tick (seqPlayerTick) runs from a root counter 2
+// interrupt at exactly SEQ_TICK_RATE Hz, independent of VMODE and frame time
+// SEQ_TICK_RCNT 0: the sequencer tick runs from the VSync callback (60Hz NTSC / 50Hz PAL)
+#define SEQ_TICK_RCNT 1
+#define SEQ_TICK_RATE 240           // Hz, must be >= 65 (16-bit counter target)
+#define RCNT2_CLOCK 4233600         // Root counter 2 runs at system clock / 8
+#define RCNT2_TO_US(c) (((c) * 1000) / (RCNT2_CLOCK / 1000))
+
+#if SEQ_TICK_RCNT
+#define SEQ_CLOCK_HZ SEQ_TICK_RATE
+#else
+#define SEQ_CLOCK_HZ (VMODE ? 50 : 60)
+#endif
+
+// Frame profiler (Select+Start toggles the overlay)
+// Timestamps come from root counter 2, so it needs SEQ_TICK_RCNT
+#define PROFILE_FRAME SEQ_TICK_RCNT
+#define PROF_WINDOW 64              // Frames kept for min/avg/max
+
+// Native sequencer
+#define SEQ_EVENT_POOL 16384        // Decoded events shared by all SEQ files (8 bytes each)
+#define SEQ_UNPACK_SIZE 65536       // Largest compressed or disc SEQ (expanded or read here to decode it, LZ_ASSETS or CD_ASSETS)
+#define SEQ_MAX_CHECKPOINTS 512     // Seek index of the current sequence (one per bar or coarser)
+#define SEQ_MAX_TEMPOS 256          // Tempo map entries of the current sequence
+#define SPU_NUM_VOICES 24
+
+// ADSR editor curve: attack, decay, sustain and release side by side, each
+// scaled to its own length, to the right of the hex values
+#define ADSR_CURVE_X 200
+#define ADSR_CURVE_Y 12
+#define ADSR_CURVE_W 28             // Points per phase
+#define ADSR_CURVE_H 40
+#define ADSR_CURVE_HOLD SPU_ENV_RATE  // Samples shown of the sustain, and of phases that never end
+
+// SPU registers read by the voice monitor
+#define SPU_VOICE_REG(v, r) (*(volatile u_short*)(u_long)(0x1F801C00 + ((v) << 4) + (r)))
+#define SPU_VOICE_VOL_L 0x0
+#define SPU_VOICE_VOL_R 0x2
+#define SPU_VOICE_PITCH 0x4
+#define SPU_VOICE_ENV 0xC           // Current ADSR volume
+#define SPU_ENDX_LO (*(volatile u_short*)0x1F801D9C)
+#define SPU_ENDX_HI (*(volatile u_short*)0x1F801D9E)
+
+// SPU registers written by the audition voice driver
+#define SPU_VOICE_ADDR 0x6          // Sample start address / 8
+#define SPU_VOICE_ADSR1 0x8
+#define SPU_VOICE_ADSR2 0xA
+#define SPU_KON_LO (*(volatile u_short*)0x1F801D88)
+#define SPU_KON_HI (*(volatile u_short*)0x1F801D8A)
+#define SPU_KOFF_LO (*(volatile u_short*)0x1F801D8C)
+#define SPU_KOFF_HI (*(volatile u_short*)0x1F801D8E)
+#define SPU_EON_LO (*(volatile u_short*)0x1F801D98)  // Voices sent to reverb
+#define SPU_EON_HI (*(volatile u_short*)0x1F801D9A)
+#define SPU_PITCH_MAX 0x3FFF
+#define SPU_VOLUME_MAX 0x3FFF
+
+// Voice driver: notes are keyed on by writing the voice registers from a
+// table of the soundbank's tones, and KON/KOFF are written once per tick
+#define DRV_MAX_TONES (128 * 16)     // One block of 16 tones per program
+
+// Polyphonic audition (VAB mode): notes held at once, one voice each
+#define AUDITION_SLOTS SPU_NUM_VOICES
+
+// File lists longer than this scroll
+#define LIST_ROWS 12
+
+// Soundbank cache: VBs stay in SPU RAM until the space is needed
+#define VAB_CACHE_SLOTS 16          // libsnd VAB ids
+#define SPU_RAM_BASE 0x1010         // After the capture buffers and libsnd's silent block
+#define SPU_RAM_END (0x80000 - 0x18040)  // Below the largest reverb work area (echo/delay)
+#define VAB_CHUNK PAK_BLOCK         // VB bytes sent to the SPU per frame while loading (one LZ block)
+#define VAB_LOADING -2              // vabCacheBegin/vabCacheStep: upload still running
+
+// Disc build (CD_ASSETS): SEQs and samples are in DISC.PAK on the CD
+#define CD_SECTOR PAK_SECTOR
+#define CD_INDEX_SIZE ((sizeof(PakHeader) + (MAX_SEQ_FILES + MAX_VH_FILES + 1) * sizeof(PakEntry) + CD_SECTOR - 1) & ~(CD_SECTOR - 1))
+
+// Serial hot-load (hotload.h, tools/hotload): Triangle on the SEQ list
+#define HOT_RAM_SIZE 262144         // Received files, kept until one of the same name replaces them
+#define HOT_FILES 16                // Received files kept at once
+#define HOT_TIMEOUT 180             // Frames without a good packet before a transfer is dropped
+#define HOT_PACKET_TIMEOUT 15       // Frames of silence inside a packet before it is dropped
+#define SEQ_LIST_SIZE (MAX_SEQ_FILES + HOT_FILES)
+#define VH_LIST_SIZE (MAX_VH_FILES + HOT_FILES)
+
+// SIO1 (serial port) registers
+#define SIO_RING 4096               // Receive ring filled by the SIO interrupt (power of 2)
+#define SIO_DATA (*(volatile u_char*)0x1F801050)
+#define SIO_STAT (*(volatile u_long*)0x1F801054)
+#define SIO_MODE (*(volatile u_short*)0x1F801058)
+#define SIO_CTRL (*(volatile u_short*)0x1F80105A)
+#define SIO_BAUD (*(volatile u_short*)0x1F80105E)
+#define SIO_STAT_TX_READY 0x0001
+#define SIO_STAT_RX_READY 0x0002
+#define SIO_STAT_OVERRUN 0x0010
+#define SIO_CTRL_TX 0x0001
+#define SIO_CTRL_DTR 0x0002
+#define SIO_CTRL_RX 0x0004
+#define SIO_CTRL_ACK 0x0010
+#define SIO_CTRL_RTS 0x0020
+#define SIO_CTRL_RESET 0x0040
+#define SIO_CTRL_RX_IRQ 0x0800      // Interrupt on every received byte
+#define SIO_MODE_8N1 0x004E         // 8 data bits, no parity, 1 stop bit, baud factor 16
+#define SIO_CLOCK 2116800           // 33.8688MHz / 16
+#define SIO_IRQ 8
+
+// Soundbank edits saved on the memory card (Select+X in the program and tone
+// editors). One card file per soundbank holds only the changed bytes
+#define EDIT_LOG_SIZE 1024          // Changed bytes kept for all soundbanks (fits in one card block)
+#define EDIT_BANKS VH_LIST_SIZE     // Soundbanks whose card file has been read this session
+#define EDIT_PROGRAM 0xFF           // EditRecord.tone of a ProgAtr byte
+#define EDIT_HEADER 0xFF            // EditRecord.program of a VabHdr byte
+#define EDIT_MAGIC 0x54444556       // "VEDT"
+#define CARD_FRAME 128              // Card files are read and written in whole frames
+#define CARD_BLOCK 8192
+#define CARD_DATA (2 * CARD_FRAME)  // After the title and icon frames
+
 DISPENV disp[2];
 DRAWENV draw[2];
 short db = 0;
@@ -32,7 +163,10 @@ typedef enum {
     STATE_VAB_PLAYBACK,
     STATE_PROGRAM_EDIT,
     STATE_TONE_EDIT,
-    STATE_ADSR_EDIT
+    STATE_ADSR_EDIT,
+    STATE_VOICE_MONITOR,
+    STATE_VAB_LOADING,
+    STATE_HOT_LOAD
 } UIState;
 
 // Playback menu items (SEQ mode)
@@ -41,6 +175,7 @@ typedef enum {
     MENU_PAUSE,
     MENU_STOP,
     MENU_TEMPO,
+    MENU_SEEK,
     MENU_REV_TYPE,
     MENU_REV_DEPTH,
     MENU_REV_DELAY,
@@ -53,6 +188,7 @@ typedef enum {
 typedef enum {
     VAB_MENU_NOTE,
     VAB_MENU_PROGRAM,
+    VAB_MENU_CHORD,
     VAB_MENU_REV_TYPE,
     VAB_MENU_REV_DEPTH,
     VAB_MENU_REV_DELAY,
@@ -129,7 +265,11 @@ typedef struct {
     char name[32];
     u_char* data;
     u_int size;
-    u_char type; // 0=seq, 1=vh
+    u_char type; // PAK_SEQ, PAK_VH
+    u_char flags; // PAK_FLAG_LZ: data is LZ blocks, size is the expanded size
+    PakEntry* entry; // Archive index entry (a disc file has no data, it is read from here)
+    u_char hot; // Received over the serial port (data is in hot_ram, no entry)
+    u_int hash; // pakHash of the file as packed or sent (names the soundbank's card file)
 } FileEntry;
 
 // Audio file structure
@@ -143,24 +283,294 @@ typedef struct {
     char seq_name[32];
     char vh_name[32];
     short vab_id;
-    short seq_id;
+    SeqSong* song;       // Decoded sequence
     u_short num_programs;
     u_short num_tones;
 } AudioFile;
 
-// File counts and extern declarations are now in fileconfig.h
-// MAX_SEQ_FILES and MAX_VH_FILES are defined there
-// All extern declarations are generated at build time
+// Sequencer state (owned by the clock interrupt while active)
+typedef struct {
+    SeqSong* song;
+    int cursor;              // Next event to dispatch
+    u_int tick;              // Current song tick
+    // Exact tick clock: every interrupt adds resolution * 1000000 * scale_num
+    // accumulator units, one tick costs tempo * SEQ_CLOCK_HZ * scale_den units
+    unsigned long long tick_acc;   // Fractional tick in accumulator units
+    unsigned long long tick_cost;  // Accumulator units per tick
+    unsigned long long tick_rem;   // Accumulator units added per interrupt beyond tick_whole
+    u_int tick_whole;        // Whole ticks per interrupt
+    u_int tempo;             // Current usec per quarter note from the song
+    u_int scale_num;         // User tempo scale (menu BPM / song BPM)
+    u_int scale_den;
+    int active;              // Clock interrupt advances the song
+    SeqChannelState chan;
+} SeqPlayer;
+
+// Voice allocator states
+#define VOICE_FREE 0
+#define VOICE_RELEASED 1     // Keyed off, envelope may still be sounding
+#define VOICE_HELD 2
+
+// Frame phases timed by the profiler
+typedef enum {
+    PROF_INPUT,
+    PROF_BACKGROUND,
+    PROF_UI,
+    PROF_OVERLAY,           // The profiler's own overlay
+    PROF_FLUSH,
+    PROF_DRAWSYNC,          // Waiting for the GPU
+    PROF_VSYNC,             // Idle until the next frame
+    PROF_SOUND,             // Sound tick interrupts during the frame
+    PROF_PHASE_COUNT
+} ProfPhase;
+
+// Voice started by the sequencer (needed for key off and pitch bend)
+typedef struct {
+    char channel;            // -1 = free
+    u_char note;
+    u_char program;
+    u_char tone;
+} SeqVoice;
+
+// Voice registers captured once per frame by the voice monitor
+typedef struct {
+    u_short vol_l[SPU_NUM_VOICES];
+    u_short vol_r[SPU_NUM_VOICES];
+    u_short pitch[SPU_NUM_VOICES];
+    u_short env[SPU_NUM_VOICES];
+    u_short release_frames[SPU_NUM_VOICES];  // Frames spent keyed off with a non-zero envelope
+    u_long endx;                             // Voices that reached a sample end flag
+    int sounding;                            // Voices with a non-zero envelope
+    int sounding_peak;
+} SpuVoiceSnapshot;
+
+// Soundbank resident in SPU RAM
+typedef struct {
+    short vab_id;            // -1 = empty
+    short vh;                // Index in vh_files
+    u_long addr;             // SPU RAM address of the VB
+    u_long size;
+    u_long sent;             // VB bytes handed to the SPU DMA so far
+    const u_char* next;      // Next stored block of a compressed VB
+    u_long last_used;        // vab_cache_serial at the last open
+} VabCacheSlot;
+
+// Voice driver: what a key-on needs for one tone, resolved from the VH and
+// the VAG addresses when the table is built
+typedef struct {
+    u_short addr;            // SPU RAM address / 8 of the tone's VAG, 0 if it has none
+    u_short pitch;           // Pitch register at the center note, fine tune included
+    u_short adsr1;
+    u_short adsr2;
+    u_short vol_l;           // Volume registers at full velocity
+    u_short vol_r;
+    u_char center;
+    u_char reverb;
+    u_char pbmin;            // Pitch bend range down and up, semitones
+    u_char pbmax;
+} DrvTone;
+
+// Note held in VAB mode
+typedef struct {
+    short voice;             // -1 = free
+    u_char note;
+    u_char latched;          // Held with X, Triangle does not release it
+} AuditionSlot;
+
+// Notes Triangle plays in VAB mode: semitones from NOTE
+typedef struct {
+    const char* name;
+    int count;
+    signed char intervals[AUDITION_SLOTS];
+} AuditionChord;
+
+// File received over the serial port
+typedef struct {
+    char name[PAK_NAME_SIZE];
+    u_char type;             // PAK_SEQ, PAK_VH, PAK_VB
+    u_char* data;            // In hot_ram, 16-byte aligned
+    u_long size;
+    u_int hash;              // HotHeader.hash
+} HotFile;
+
+// Receive mode parser: looking for HOT_MAGIC, or collecting a packet
+typedef enum {
+    HOT_PHASE_SYNC,
+    HOT_PHASE_HEADER,
+    HOT_PHASE_CHUNK_HEAD,
+    HOT_PHASE_CHUNK
+} HotPhase;
+
+// Changed soundbank byte: a VagAtr byte of a tone, a ProgAtr byte (tone is
+// EDIT_PROGRAM) or a VabHdr byte (program is EDIT_HEADER), and its new value
+typedef struct {
+    u_char program;
+    u_char tone;
+    u_char offset;           // In the VagAtr, ProgAtr or VabHdr
+    u_char value;
+} EditRecord;
+
+// Card file data, after the title and icon frames: this header, then count EditRecords
+typedef struct {
+    u_int magic;             // EDIT_MAGIC
+    u_int hash;              // FileEntry.hash of the soundbank
+    u_short count;
+    u_short reserved;
+    u_int check;             // pakHash of the records
+} EditHeader;
+
+// Bank whose VAGs are in the shared sample pool (VB_POOL, see tools/vbpool.c)
+typedef struct {
+    char* name;              // VH file name
+    int num_vags;
+    const u_long* offsets;   // Pool offset of each VAG (VAG number - 1)
+} VbPoolBank;
+
+// File lists, filled from the assets.pak index by loadAudioFiles.
+// MAX_SEQ_FILES and MAX_VH_FILES (fileconfig.h) are the files the Makefile
+// packed, files received over the serial port are listed after them
+FileEntry seq_files[SEQ_LIST_SIZE];
+FileEntry vh_files[VH_LIST_SIZE];
+u_char* vb_files[VH_LIST_SIZE];  // VB of each VH (none with VB_POOL, the samples are in the pool)
+u_char vb_flags[VH_LIST_SIZE];   // PAK_FLAG_LZ: VB is stored as LZ blocks
+#if LZ_ASSETS
+u_char pak_block[PAK_BLOCK];     // Expanded block of a compressed VB or pool on its way to the SPU
+#endif
+#if LZ_ASSETS || CD_ASSETS
+u_long seq_unpack[SEQ_UNPACK_SIZE / 4];  // Word aligned for CdRead
+#endif
+int num_seq_files = 0;
+int num_vh_files = 0;
+int num_seq_static = 0;          // Packed files, the received ones follow
+int num_vh_static = 0;
+int pak_bad_files = 0;           // Entries whose contents do not match their hash
+#if VB_POOL
+VbPoolBank vb_pool_banks[MAX_VH_FILES] = VB_POOL_BANKS;
+int vb_pool_ok = 0;              // Pool uploaded and matching its hash
+#endif
+
+// Disc build: only the index of DISC.PAK is in RAM. A SEQ is read when it is
+// chosen, a VB a chunk at a time while the previous chunk goes to the SPU
+#if CD_ASSETS
+u_long disc_index[CD_INDEX_SIZE / 4];
+u_long disc_sector = 0;              // First sector of DISC.PAK
+u_long vb_sectors[VH_LIST_SIZE];     // First sector of each VB
+u_int vb_hashes[VH_LIST_SIZE];       // pakHash of each VB, checked as it is read
+u_int cd_hash;                       // pakHash of the chunks of the VB being read
+u_long cd_buffers[2][VAB_CHUNK / 4];
+int cd_buffer = 0;                   // Buffer receiving the next chunk to send
+int cd_reading = 0;                  // CdRead into cd_buffer not finished yet
+int cd_ready = 0;                    // cd_buffer holds the next chunk to send
+int cd_retries = 0;                  // Failed reads retried
+#define STREAM_PAK ((u_char*)disc_index)
+#else
+#define STREAM_PAK ASSET_PAK         // Archive holding the SEQs and samples
+#endif
+
+// Decoded sequences. Packed SEQs are decoded once by loadAudioFiles, disc and
+// received ones by seqLoad when they are chosen, after seq_pool_static
+SeqEvent seq_event_pool[SEQ_EVENT_POOL];
+SeqSong seq_songs[SEQ_LIST_SIZE];
+int seq_pool_static = 0;             // Events decoded at startup
+int seq_loaded = -1;                 // seq_files entry decoded by seqLoad
+
+// Serial hot-load: received files, and the receive ring filled by sioInterrupt
+u_long hot_ram[HOT_RAM_SIZE / 4];
+u_long hot_used = 0;
+HotFile hot_files[HOT_FILES];
+int hot_count = 0;
+HotPhase hot_phase = HOT_PHASE_SYNC;
+HotHeader hot_header;                // File being received
+u_char hot_packet[HOT_CHUNK_HEAD + HOT_CHUNK + HOT_CHUNK_TAIL];
+int hot_packet_size = 0;
+int hot_packet_want = 0;
+u_long hot_sync = 0;                 // Last 4 bytes seen while looking for HOT_MAGIC
+u_long hot_received = 0;             // Bytes of the file so far
+int hot_next_chunk = 0;
+int hot_quiet = 0;                   // Frames since the last byte
+int hot_stalled = 0;                 // Frames since the last good packet
+u_long hot_retries = 0;              // Packets answered HOT_NAK
+char hot_status[64];                 // Result of the last file
+volatile u_char sio_ring[SIO_RING];
+volatile u_int sio_head = 0;         // Written by sioInterrupt
+u_int sio_tail = 0;
+volatile u_long sio_overruns = 0;    // Bytes lost (ring or FIFO full)
+
+// Soundbank edits: every changed byte of every soundbank this session, and
+// those read from the card. A VH gets them (editApply) before libsnd opens it
+EditRecord edit_log[EDIT_LOG_SIZE];
+u_int edit_log_hash[EDIT_LOG_SIZE];  // FileEntry.hash of the soundbank
+int edit_count = 0;
+u_int edit_banks[EDIT_BANKS];        // Soundbanks whose card file has been read
+int edit_num_banks = 0;
+u_long card_buffer[CARD_BLOCK / 4];  // Card file being read or written
+char edit_status[48];                // Result of the last save
+
+// Native sequencer
+SeqPlayer seq_player;
+SeqVoice seq_voices[SPU_NUM_VOICES];
 
-// File lists - initialized from generated macros
-FileEntry seq_files[MAX_SEQ_FILES] = SEQ_FILES_INIT;
+// Voice allocator
+// Every used voice is in one class: released voices by priority (0-15) then
+// held voices by priority (16-31). A class is a list in the order its voices
+// joined it (held voices by key-on, released ones by key-off), and
+// voice_classes has a bit for each non-empty class. The victim is the head of
+// the lowest class with a bit set, so a steal takes no scan of the voices
+u_char voice_state[SPU_NUM_VOICES];
+u_char voice_prior[SPU_NUM_VOICES];
+u_char voice_older[SPU_NUM_VOICES];    // Class list links, valid while in the class
+u_char voice_newer[SPU_NUM_VOICES];
+u_char class_oldest[32];               // Valid while the class bit is set
+u_char class_newest[32];
+u_long voice_classes = 0;
+u_long voice_free_mask = (1 << SPU_NUM_VOICES) - 1;
+int voice_active = 0;                  // Held voices
+int voice_peak = 0;                    // Most held voices at once
+u_long voice_steals = 0;               // Held voices taken over by a new note
+u_long voice_refused = 0;              // Key-ons dropped (every voice held at higher priority)
 
-FileEntry vh_files[MAX_VH_FILES] = VH_FILES_INIT;
+// Voice monitor
+SpuVoiceSnapshot spu_snapshot;
 
-u_char* vb_files[MAX_VH_FILES] = VB_FILES_INIT;
+// Voice driver: tone table of the soundbank with VAB id drv_vab (tone blocks
+// in vab_prog_block), and the key-ons and key-offs of the current tick
+DrvTone drv_tones[DRV_MAX_TONES];
+u_short drv_note_tones[128][128];      // Tones of each program covering each note (bit per tone)
+short drv_vab = -1;                    // -1: no table
+u_long drv_kon = 0;                    // Voices to key on at drvCommit
+u_long drv_koff = 0;                   // Voices to key off at drvCommit
+u_long drv_koff_next = 0;              // Keyed on and off in one tick: off at the next commit
+u_long drv_eon = 0;                    // Voices sent to reverb
+u_long drv_eon_written = 0;
+u_long drv_kon_writes = 0;             // KON mask writes
+u_long drv_keyons = 0;                 // Voices keyed on by them
+#if PROFILE_FRAME
+u_long pad_time = 0;                   // profNow() when the pad was read this frame
+u_long keyon_cost = 0;                 // Last key-on call (RCnt2 counts)
+u_long keyon_cost_max = 0;
+u_long keyon_latency = 0;              // Pad read to key-on of the last note (RCnt2 counts)
+#endif
+
+// Seek index of the sequence in seq_index_song
+SeqCheckpoint seq_checkpoints[SEQ_MAX_CHECKPOINTS];
+int seq_num_checkpoints = 0;
+u_int seq_checkpoint_interval = 0;  // Ticks between checkpoints
+SeqSong* seq_index_song = NULL;
 
-// SEQ attribute table (required by libsnd)
-char seq_table[SS_SEQ_TABSIZ * MAX_SEQ_FILES * MAX_VH_FILES];
+// Tempo map of the sequence in seq_index_song (for song time display)
+SeqTempoEntry seq_tempo_map[SEQ_MAX_TEMPOS];
+int seq_num_tempos = 0;
+short vab_prog_block[128];  // Tone block of each program in the VH, -1 if it has no tones
+
+// Soundbank cache
+VabCacheSlot vab_cache[VAB_CACHE_SLOTS];
+u_long vab_cache_serial = 0;
+int vab_cache_hits = 0;
+int vab_cache_loads = 0;
+int vab_cache_evictions = 0;
+int vab_load_slot = -1;                 // Slot being uploaded, -1 if none
+UIState load_next_state = STATE_PLAYBACK;   // Entered once the upload completes
+UIState load_return_state = STATE_VH_SELECT; // Entered on cancel or failure
 
 // Global state
 UIState current_state = STATE_SEQ_SELECT;
@@ -172,9 +582,42 @@ AudioFile current_audio;
 int is_playing = 0;
 int is_paused = 0;
 int pad, oldpad;
-long current_tempo = 120;  // Track current tempo (default 120 BPM)
+long current_tempo = 120;  // Track current tempo (song tempo in BPM until changed)
+long song_tempo = 120;  // Initial tempo of the selected sequence in BPM
+
+// TEMPO range: a quarter to four times the song's own tempo
+#define TEMPO_MIN (song_tempo / 4 > 0 ? song_tempo / 4 : 1)
+#define TEMPO_MAX (song_tempo * 4)
 int tempo_changed = 0;  // Track if tempo has been modified from original
 
+// Sequencer clock statistics (written by the root counter interrupt)
+#if SEQ_TICK_RCNT
+long tick_event = -1;                // Root counter 2 event handle
+volatile u_long tick_count = 0;      // Ticks handled since initSound()
+volatile u_short tick_cost_last = 0; // Cost of the last tick handler call (RCnt2 counts)
+volatile u_short tick_cost_max = 0;  // Worst tick handler cost seen (RCnt2 counts)
+volatile u_long tick_cost_total = 0; // Sum of all tick handler costs (RCnt2 counts)
+#endif
+
+// Frame profiler
+#if PROFILE_FRAME
+int prof_visible = 0;
+int prof_stream = -1;                           // Font stream of the overlay
+u_long prof_samples[PROF_PHASE_COUNT][PROF_WINDOW]; // RCnt2 counts per frame
+u_long prof_frame[PROF_PHASE_COUNT];            // Frame being measured
+int prof_pos = 0;
+int prof_filled = 0;
+u_long prof_last = 0;                           // Timestamp of the previous mark
+u_long prof_last_sound = 0;                     // tick_cost_total at the previous mark
+u_long prof_frame_sound = 0;                    // tick_cost_total at the start of the frame
+const char* prof_names[PROF_PHASE_COUNT] = {
+    "Input   ", "Bg      ", "UI      ", "Overlay ", "Flush   ", "DrawSync", "VSync   ", "Sound   "
+};
+#define PROF_MARK(phase) profMark(phase)
+#else
+#define PROF_MARK(phase)
+#endif
+
 // Background image support (16-bit TIM, 320x240 split into two primitives)
 #if HAS_BACKGROUND_IMAGE
 int bg_state = 0;       // 0=default, 1=image+text, 2=image only
@@ -195,22 +638,66 @@ short reverb_type = 0;
 int vab_mode = 0;  // 0 = SEQ mode, 1 = VAB mode
 short current_note = 60;  // Middle C (MIDI note 60)
 short current_program = 0;  // Program (instrument) number
-short current_voice = -1;  // Voice channel ID (-1 = not playing)
-int note_playing = 0;  // Is note currently playing
+int note_playing = 0;  // Is a note played by Triangle sounding
+
+// Polyphonic audition: the chord Triangle plays, the held notes, and the slot
+// of each voice so a stolen voice frees its slot without a search
+const AuditionChord audition_chords[] = {
+    {"SINGLE", 1, {0}},
+    {"MAJOR", 3, {0, 4, 7}},
+    {"MINOR", 3, {0, 3, 7}},
+    {"DOM 7", 4, {0, 4, 7, 10}},
+    {"MAJ 9", 5, {0, 4, 7, 11, 14}},
+    {"OCTAVES", 4, {-12, 0, 12, 24}},
+    {"CLUSTER 8", 8, {0, 1, 2, 3, 4, 5, 6, 7}},
+    {"STACK 16", 16, {-24, -21, -18, -15, -12, -9, -6, -3, 0, 3, 6, 9, 12, 15, 18, 21}},
+    {"STACK 24", 24, {-36, -33, -30, -27, -24, -21, -18, -15, -12, -9, -6, -3,
+                      0, 3, 6, 9, 12, 15, 18, 21, 24, 27, 30, 33}}
+};
+#define AUDITION_CHORDS (sizeof(audition_chords) / sizeof(audition_chords[0]))
+int audition_chord = 0;
+AuditionSlot audition_slots[AUDITION_SLOTS];
+signed char voice_audition[SPU_NUM_VOICES];  // Slot of each voice, -1 if none
+int audition_count = 0;                      // Notes held
+int audition_latched = 0;                    // Of which held with X
 
 // Program/Tone editing variables
 int edit_program = 0;  // Currently selected program for editing
 int edit_tone = 0;  // Currently selected tone for editing
 UIState return_state = STATE_PLAYBACK;  // State to return to from editor
 ProgAtr current_prog_atr;  // Current program attributes
-ProgAtr original_prog_atr;  // Original program attributes (for change detection)
 VagAtr current_vag_atr;  // Current tone attributes
-VagAtr original_vag_atr;  // Original tone attributes (for change detection)
 u_char vab_master_vol = 127;  // VAB master volume
 u_char vab_master_pan = 64;  // VAB master pan
 u_char original_master_vol = 127;  // Original master volume
 u_char original_master_pan = 64;  // Original master pan
 
+// Attribute cache of the soundbank with VAB id attr_vab: the editable program
+// and tone attributes, one array per field, read and written by the editors.
+// Tones are indexed by VH tone block * 16 + tone (see vab_prog_block)
+short attr_vab = -1;                       // -1: not built
+short attr_block_prog[128];                // Program of each tone block
+u_char attr_prog_mvol[128];
+u_char attr_prog_mpan[128];
+u_char attr_tone_prior[DRV_MAX_TONES];
+u_char attr_tone_mode[DRV_MAX_TONES];
+u_char attr_tone_vol[DRV_MAX_TONES];
+u_char attr_tone_pan[DRV_MAX_TONES];
+u_char attr_tone_center[DRV_MAX_TONES];
+u_char attr_tone_shift[DRV_MAX_TONES];
+u_char attr_tone_min[DRV_MAX_TONES];
+u_char attr_tone_max[DRV_MAX_TONES];
+u_char attr_tone_pbmin[DRV_MAX_TONES];
+u_char attr_tone_pbmax[DRV_MAX_TONES];
+u_short attr_tone_adsr1[DRV_MAX_TONES];
+u_short attr_tone_adsr2[DRV_MAX_TONES];
+u_short attr_prog_edited[128];             // Fields edited since the cache was built (bit per PROG_MENU item)
+u_short attr_tone_edited[DRV_MAX_TONES];   // Same, bit per TONE_MENU item
+u_long attr_prog_dirty[128 / 32];          // Programs vabAttrFlush hands to libsnd (bit each)
+u_long attr_tone_dirty[DRV_MAX_TONES / 32];  // Tones vabAttrFlush hands to libsnd
+int attr_dirty = 0;                        // Any dirty bit set
+int attr_drv_all = 0;                      // Bank volume changed: every program's driver entries
+
 // ADSR hex editing
 int adsr_editing = 0;  // 0=not editing, 1=editing ADSR1, 2=editing ADSR2
 int adsr_digit_pos = 0;  // Current digit position (0-3)
@@ -221,6 +708,11 @@ u_short adsr_original_value = 0;  // Original value (for cancel)
 int adsr_editor_active = 0;  // Which ADSR being edited: 1=ADSR1, 2=ADSR2
 AdsrParams current_adsr;  // Current ADSR parameters
 AdsrParams original_adsr;  // Original ADSR parameters (for change detection and cancel)
+SpuEnvTimes adsr_times;  // Phase lengths of the setting shown
+short adsr_curve[4 * ADSR_CURVE_W];  // Level at each point of the curve
+u_short adsr_curve_adsr1 = 0;  // Setting the curve was built for
+u_short adsr_curve_adsr2 = 0;
+int adsr_curve_valid = 0;
 
 // Hold detection (at 60Hz, 0.5 seconds = 30 frames)
 #define HOLD_THRESHOLD 30
@@ -237,7 +729,41 @@ int hold_active_down = 0;
 // Function prototypes
 void initGraph(void);
 void display(void);
+#if PROFILE_FRAME
+u_long profNow(void);
+void profReset(void);
+void profMark(int phase);
+void profEndFrame(void);
+void drawProfiler(void);
+#endif
 void initSound(void);
+#if SEQ_TICK_RCNT
+long soundTickHandler(void);
+#else
+void soundVSyncHandler(void);
+#endif
+void indexVabPrograms(void);
+void seqPlayerStart(SeqSong* song);
+void seqPlayerStop(void);
+void seqPlayerPause(int pause);
+void seqPlayerSetTempoScale(long num, long den);
+void resetTempo(void);
+void seqPlayerTick(void);
+int voiceAlloc(int prior);
+void voiceRelease(int voice);
+void drvBuild(void);
+void drvBuildProgram(int prog);
+u_short drvNoteTones(int prog, int note);
+u_short drvPitch(DrvTone* tone, int note, int bend);
+void drvKeyOn(int voice, int prog, int tone, int note, int voll, int volr, int bend);
+void drvKeyOff(int voice);
+void drvSetVolume(int voice, int voll, int volr);
+void drvSetBend(int voice, int bend);
+void drvCommit(void);
+void voiceResetStats(void);
+void readSpuVoices(void);
+void seqPlayerSeek(u_int tick);
+void seekBars(int bars);
 void processInput(void);
 #if HAS_BACKGROUND_IMAGE
 void drawBackground(void);
@@ -246,7 +772,52 @@ void drawUI(void);
 void drawSeqSelect(void);
 void drawVhSelect(void);
 void drawPlayback(void);
+void drawVoiceMonitor(void);
+const char* formatSongTime(u_int tick);
 void loadAudioFiles(void);
+PakEntry* pakFirst(u_char* pak, int type);
+int pakCheck(u_char* pak, PakEntry* entry);
+void listFile(FileEntry* file, u_char* pak, PakEntry* entry);
+SeqSong* seqLoad(int i);
+#if CD_ASSETS
+int cdReadStart(u_long sector, void* buffer, u_long size);
+int cdReadWait(u_long sector, void* buffer, u_long size);
+void cdOpenDisc(void);
+#endif
+int listTop(int count);
+u_long vabBodySize(u_char* vh);
+u_long spuRamFind(u_long size);
+void vabCacheEvict(int slot);
+int vabCacheOpen(int vh);
+#if VB_POOL
+void vbPoolUpload(void);
+int vbPoolOpen(int vh);
+#endif
+int vabCacheBegin(int vh);
+int vabCacheStep(void);
+void vabCacheCancel(void);
+void beginBankLoad(UIState next, UIState back);
+void finishBankLoad(void);
+void drawVabLoading(void);
+int vabCacheFind(int vh);
+u_long vabCacheUsed(void);
+void sioInterrupt(void);
+void sioOpen(void);
+void sioClose(void);
+int sioRead(void);
+void sioWrite(u_char c);
+int hotSameBank(const char* a, const char* b);
+void hotForget(void);
+void hotRemove(int i);
+void hotRefresh(void);
+void hotAdd(void);
+void hotHeader(void);
+void hotChunk(void);
+void hotByte(u_char c);
+void hotReceive(void);
+void enterHotLoad(void);
+void exitHotLoad(void);
+void drawHotLoad(void);
 void playSequence(void);
 void pauseSequence(void);
 void stopSequence(void);
@@ -255,6 +826,11 @@ void toggleMinMax(void);
 const char* getReverbTypeName(short type);
 void drawVabVhSelect(void);
 void drawVabPlayback(void);
+int auditionNoteOn(int note, int program, int tone, int latched);
+void auditionNoteOff(int slot);
+void auditionForget(int voice);
+void auditionChord(int latched);
+void auditionReleaseAll(void);
 void playNote(void);
 void stopNote(void);
 void adjustVabMenuValue(int direction, int amount);
@@ -263,8 +839,19 @@ void enterProgramEdit(void);
 void exitProgramEdit(void);
 void loadProgramData(void);
 void loadToneData(void);
+void vabAttrBuild(void);
+void vabAttrFlush(void);
+void selectNoteTone(void);
 void saveProgramData(void);
 void saveToneData(void);
+void cardInit(void);
+void cardName(char* name, u_int hash);
+void vhToneBlocks(u_char* vh, short* blocks);
+int editRecord(u_int hash, int program, int tone, int offset, int value);
+void editDiff(int program, int tone, u_char* old, u_char* now, int size);
+void editLoad(u_int hash);
+void editApply(int vh);
+void editSave(int vh);
 void adjustProgramEditValue(int direction, int amount);
 void toggleProgramEditMinMax(void);
 void adjustToneEditValue(int direction, int amount);
@@ -282,6 +869,9 @@ void exitAdsrEdit(int save);
 void adjustAdsrValue(int direction, int amount);
 void toggleAdsrValue(void);
 void drawAdsrEdit(void);
+void buildAdsrCurve(u_short adsr1, u_short adsr2);
+void drawAdsrCurve(void);
+void formatEnvTime(char* out, u_long samples);
 int isAdsrValueChanged(int menu_item);
 
 void initGraph(void)
@@ -309,11 +899,17 @@ void initGraph(void)
     PutDrawEnv(&draw[db]);
     
     FntLoad(960, 0);
+#if PROFILE_FRAME
+    // Overlay stream at the bottom of the screen, with its own background box
+    prof_stream = FntOpen(8, 152, 304, 80, 1, 512);
+    SetDumpFnt(FntOpen(8, 8, 304, 224, 0, 2048));
+#else
     FntOpen(8, 8, 304, 224, 0, 2048);
+#endif
 
 // Load TIM background image (supports up to 320x240 16-bit)
 #if HAS_BACKGROUND_IMAGE
-    OpenTIM((u_long*)BG_IMAGE_DATA);
+    OpenTIM((u_long*)(ASSET_PAK + pakFirst(ASSET_PAK, PAK_TIM)->offset));
     ReadTIM(&bg_tim);
     
     // Load pixel data to VRAM
@@ -364,7 +960,9 @@ void display(void)
 #endif
     
     DrawSync(0);
+    PROF_MARK(PROF_DRAWSYNC);
     VSync(0);
+    PROF_MARK(PROF_VSYNC);
     PutDispEnv(&disp[db]);
     PutDrawEnv(&draw[db]);
     db = !db;
@@ -375,13 +973,9 @@ void initSound(void)
     // Initialize sound library
     SsInit();
     
-    // Set up SEQ attribute table
-    SsSetTableSize(seq_table, MAX_SEQ_FILES, MAX_VH_FILES);
-    
-    // Set tick mode to SS_TICK240 for correct tempo (240Hz timing)
-    // SS_TICK60 causes sequences to play too fast, SS_TICK240 seems to have tempo isseus
-	// SFG recommended an arbitrary tickrate of 97
-    SsSetTickMode(97);
+    // No library timer: sequences are played by seqPlayerTick() and libsnd's
+    // own tick (SsSeqCalledTbyT) is called from the same interrupt
+    SsSetTickMode(SS_NOTICK | SEQ_CLOCK_HZ);
     
     // Set master volume
     SsSetMVol(127, 127);
@@ -389,198 +983,1958 @@ void initSound(void)
     // Start sound system
     SsStart();
 
-	
+#if SEQ_TICK_RCNT
+    // Root counter 2 interrupts every RCNT2_CLOCK / SEQ_TICK_RATE counts and resets,
+    // so tempo no longer depends on VSync or on how long DrawSync() takes.
+    // RCntMdSC selects the system clock / 8 that RCNT2_CLOCK assumes
+    EnterCriticalSection();
+    tick_event = OpenEvent(RCntCNT2, EvSpINT, EvMdINTR, soundTickHandler);
+    EnableEvent(tick_event);
+    SetRCnt(RCntCNT2, RCNT2_CLOCK / SEQ_TICK_RATE, RCntMdINTR | RCntMdSC);
+    StartRCnt(RCntCNT2);
+    ExitCriticalSection();
+#else
+    VSyncCallback(soundVSyncHandler);
+#endif
 }
 
-void loadAudioFiles(void)
+#if SEQ_TICK_RCNT
+long soundTickHandler(void)
+{
+    // The counter restarted from 0 when the interrupt fired, so the difference
+    // between entry and exit is the handler cost in RCnt2 counts
+    u_short start = GetRCnt(RCntCNT2);
+    u_short cost;
+    
+    seqPlayerTick();
+    drvCommit();
+    SsSeqCalledTbyT();
+    
+    cost = GetRCnt(RCntCNT2) - start;
+    tick_cost_last = cost;
+    if (cost > tick_cost_max) tick_cost_max = cost;
+    tick_cost_total += cost;
+    tick_count++;
+    
+    return 0;
+}
+#else
+void soundVSyncHandler(void)
+{
+    seqPlayerTick();
+    drvCommit();
+    SsSeqCalledTbyT();
+}
+#endif
+
+#if PROFILE_FRAME
+// ====================
+// Frame Profiler
+// ====================
+
+u_long profNow(void)
+{
+    u_long ticks;
+    u_long count;
+    
+    // Counter 2 restarts every tick, so ticks handled * period + counter is a
+    // running timestamp. Read again if a tick interrupt came in between
+    do {
+        ticks = tick_count;
+        count = GetRCnt(RCntCNT2);
+    } while (ticks != tick_count);
+    
+    return ticks * (RCNT2_CLOCK / SEQ_TICK_RATE) + count;
+}
+
+void profReset(void)
 {
     int i;
-    VabHdr* vab_hdr;
     
-    // Get VH file info from headers
-    for (i = 0; i < MAX_VH_FILES; i++) {
-        vab_hdr = (VabHdr*)vh_files[i].data;
-        vh_files[i].size = vab_hdr->fsize;
+    for (i = 0; i < PROF_PHASE_COUNT; i++) {
+        prof_frame[i] = 0;
     }
+    prof_pos = 0;
+    prof_filled = 0;
+    prof_last = profNow();
+    prof_last_sound = tick_cost_total;
+    prof_frame_sound = prof_last_sound;
+}
+
+void profMark(int phase)
+{
+    u_long now = profNow();
+    u_long sound = tick_cost_total;
+    long cost;
     
-    // Initialize current audio structure
-    current_audio.vab_id = -1;
-    current_audio.seq_id = -1;
+    // Time since the previous mark minus the sound interrupts that ran inside it
+    cost = (long)(now - prof_last) - (long)(sound - prof_last_sound);
+    if (cost > 0) prof_frame[phase] += cost;
+    
+    prof_last = now;
+    prof_last_sound = sound;
 }
 
-void playSequence(void)
+void profEndFrame(void)
 {
-    if (is_playing) {
-        stopSequence();
-    }
+    int i;
+    u_long sound = tick_cost_total;
     
-    // Reset tempo to default
-    current_tempo = 120;
-    tempo_changed = 0;  // Mark as unchanged
+    prof_frame[PROF_SOUND] = sound - prof_frame_sound;
+    prof_frame_sound = sound;
     
-    // Check if VAB is already loaded (e.g., from previous play or editing)
-    // If so, reuse it to preserve any edits made in program editor
-    if (current_audio.vab_id < 0) {
-        // Open VAB header (VH)
-        current_audio.vab_id = SsVabOpenHead(current_audio.vh_data, -1);
-        if (current_audio.vab_id < 0) {
-            FntPrint("Failed to open VAB header!\n");
-            return;
-        }
-        
-        // Transfer VAB body (VB) to SPU
-        if (SsVabTransBody(current_audio.vb_data, current_audio.vab_id) != current_audio.vab_id) {
-            FntPrint("Failed to transfer VAB body!\n");
-            SsVabClose(current_audio.vab_id);
-            current_audio.vab_id = -1;
-            return;
+    for (i = 0; i < PROF_PHASE_COUNT; i++) {
+        prof_samples[i][prof_pos] = prof_frame[i];
+        prof_frame[i] = 0;
+    }
+    prof_pos = (prof_pos + 1) % PROF_WINDOW;
+    if (prof_filled < PROF_WINDOW) prof_filled++;
+}
+
+void drawProfiler(void)
+{
+    int i, f;
+    u_long min, max, sum;
+    u_long busy = 0;
+    u_long frame = 0;
+    
+    if (!prof_visible || prof_filled == 0) return;
+    
+    FntPrint(prof_stream, "PHASE      MIN   AVG   MAX us\n");
+    for (i = 0; i < PROF_PHASE_COUNT; i++) {
+        min = 0xFFFFFFFF;
+        max = 0;
+        sum = 0;
+        for (f = 0; f < prof_filled; f++) {
+            if (prof_samples[i][f] < min) min = prof_samples[i][f];
+            if (prof_samples[i][f] > max) max = prof_samples[i][f];
+            sum += prof_samples[i][f];
         }
+        sum /= prof_filled;
+        frame += sum;
+        if (i != PROF_VSYNC) busy += sum;
         
-        // Wait for transfer to complete
-        SsVabTransCompleted(SS_WAIT_COMPLETED);
+        FntPrint(prof_stream, "%s %5d %5d %5d\n", prof_names[i],
+                 RCNT2_TO_US(min), RCNT2_TO_US(sum), RCNT2_TO_US(max));
     }
-    // If VAB is already loaded, we reuse it (preserves program edits)
+    FntPrint(prof_stream, "Busy %d%% of %dus", frame ? (busy * 100) / frame : 0,
+             RCNT2_TO_US(frame));
+    FntFlush(prof_stream);
+}
+#endif
+
+// ====================
+// Voice Allocator
+// ====================
+
+static int lowestBit(u_long mask)
+{
+    int bit = 0;
     
-    // Open sequence (cast to unsigned long* as required by API)
-    current_audio.seq_id = SsSeqOpen((unsigned long*)current_audio.seq_data, current_audio.vab_id);
-    if (current_audio.seq_id < 0) {
-        FntPrint("Failed to open sequence!\n");
-        return;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        bit++;
+    }
+    return bit;
+}
+
+static void voiceSetState(int voice, int state, int prior)
+{
+    u_long bit = 1 << voice;
+    int cls;
+    
+    // Leave the old class
+    if (voice_state[voice] == VOICE_FREE) {
+        voice_free_mask &= ~bit;
+    } else {
+        cls = (voice_state[voice] - 1) * 16 + voice_prior[voice];
+        if (class_oldest[cls] == voice && class_newest[cls] == voice) {
+            voice_classes &= ~(1 << cls);
+        } else if (class_oldest[cls] == voice) {
+            class_oldest[cls] = voice_newer[voice];
+        } else if (class_newest[cls] == voice) {
+            class_newest[cls] = voice_older[voice];
+        } else {
+            voice_newer[voice_older[voice]] = voice_newer[voice];
+            voice_older[voice_newer[voice]] = voice_older[voice];
+        }
+        if (voice_state[voice] == VOICE_HELD) voice_active--;
     }
     
-    // Set sequence volume
-    SsSeqSetVol(current_audio.seq_id, 127, 127);
+    // Join the new one as its newest voice
+    voice_state[voice] = state;
+    voice_prior[voice] = prior;
+    if (state == VOICE_FREE) {
+        voice_free_mask |= bit;
+    } else {
+        cls = (state - 1) * 16 + prior;
+        if (voice_classes & (1 << cls)) {
+            voice_older[voice] = class_newest[cls];
+            voice_newer[class_newest[cls]] = voice;
+        } else {
+            class_oldest[cls] = voice;
+            voice_classes |= 1 << cls;
+        }
+        class_newest[cls] = voice;
+        if (state == VOICE_HELD) {
+            voice_active++;
+            if (voice_active > voice_peak) voice_peak = voice_active;
+        }
+    }
+}
 
-	//Enable reverb
-	SsUtSetReverbType(reverb_type);
-	SsUtReverbOn();
+static void voiceReclaim(void)
+{
+    char status[SPU_NUM_VOICES];
+    int v;
+    
+    // Released voices whose envelope reached zero are free again
+    SpuGetAllKeysStatus(status);
+    for (v = 0; v < SPU_NUM_VOICES; v++) {
+        if (voice_state[v] == VOICE_RELEASED && status[v] == SPU_OFF) {
+            voiceSetState(v, VOICE_FREE, 0);
+        }
+    }
+}
 
-	
+int voiceAlloc(int prior)
+{
+    u_long classes;
+    int voice;
     
-    // Play sequence (infinite loop)
-    SsSeqPlay(current_audio.seq_id, SSPLAY_PLAY, SSPLAY_INFINITY);
+    prior &= 0x0F;
+    
+    if (voice_free_mask == 0) {
+        voiceReclaim();
+    }
+    
+    if (voice_free_mask != 0) {
+        voice = lowestBit(voice_free_mask);
+    } else {
+        // Released voices of any priority first, then held voices up to the new
+        // note's priority (classes 0 to 16 + prior). Held voices above it are
+        // never stolen
+        classes = voice_classes & (0xFFFFFFFF >> (15 - prior));
+        if (classes == 0) {
+            voice_refused++;
+            return -1;
+        }
+        voice = class_oldest[lowestBit(classes)];
+        
+        if (voice_state[voice] == VOICE_HELD) {
+            voice_steals++;
+        }
+        drvKeyOff(voice);
+        seq_voices[voice].channel = -1;
+        auditionForget(voice);
+    }
+    
+    voiceSetState(voice, VOICE_HELD, prior);
+    return voice;
+}
 
-	//Set to default values
-	SsUtSetReverbDepth (reverb_depth_left, reverb_depth_right);
+void voiceRelease(int voice)
+{
+    if (voice_state[voice] == VOICE_HELD) {
+        voiceSetState(voice, VOICE_RELEASED, voice_prior[voice]);
+    }
+}
 
-    is_playing = 1;
+void voiceResetStats(void)
+{
+    voice_peak = voice_active;
+    voice_steals = 0;
+    voice_refused = 0;
+    drv_kon_writes = 0;
+    drv_keyons = 0;
+    spu_snapshot.sounding_peak = 0;
 }
 
-void stopSequence(void)
+// ====================
+// Voice driver
+// ====================
+
+// 2^(n/12) in 16.16 fixed point
+static const u_long drv_semitones[13] = {
+    65536, 69433, 73562, 77936, 82570, 87480, 92682, 98193, 104032, 110218, 116772, 123715, 131072
+};
+
+// Tone table of the current soundbank. Volumes follow seqrender's law at
+// full velocity: tone, program and bank volume, tone pan offset by program pan
+void drvBuild(void)
 {
-    if (is_playing && current_audio.seq_id >= 0) {
-        SsSeqStop(current_audio.seq_id);
-        SsSeqClose(current_audio.seq_id);
-        is_playing = 0;
-    }
+    int prog;
     
-    // Keep VAB loaded so program editing works when stopped
-    // VAB will be closed when changing files or in cleanup
+    drv_vab = -1;
+    if (current_audio.vab_id < 0) return;
+    indexVabPrograms();
+    for (prog = 0; prog < 128; prog++) {
+        drvBuildProgram(prog);
+    }
+    drv_vab = current_audio.vab_id;
+}
+
+// Table entries of one program's tones (after an edit, see saveToneData)
+void drvBuildProgram(int prog)
+{
+    VabHdr* vab_hdr = (VabHdr*)current_audio.vh_data;
+    ProgAtr* prog_atr = (ProgAtr*)(current_audio.vh_data + sizeof(VabHdr)) + prog;
+    VagAtr* tones;
+    VagAtr* atr;
+    DrvTone* tone;
+    u_short* note_tones = drv_note_tones[prog];
+    int block = vab_prog_block[prog];
+    int t, n, vol, pan, left, right;
+    
+    memset(note_tones, 0, sizeof(drv_note_tones[0]));
+    if (block < 0) return;
+    tones = (VagAtr*)(current_audio.vh_data + sizeof(VabHdr) + 128 * sizeof(ProgAtr)) + block * 16;
+    
+    // Notes each tone's range covers. Overlapping ranges are layered tones
+    for (t = 0; t < prog_atr->tones && t < 16; t++) {
+        for (n = tones[t].min; n <= tones[t].max && n < 128; n++) {
+            note_tones[n] |= 1 << t;
+        }
+    }
     
-    current_audio.seq_id = -1;
-    current_tempo = 120;  // Reset tempo to default
-    tempo_changed = 0;  // Mark as unchanged
-    is_paused = 0;  // Reset pause state
+    for (t = 0; t < 16; t++) {
+        atr = &tones[t];
+        tone = &drv_tones[block * 16 + t];
+        
+        tone->addr = (atr->vag > 0 && atr->vag <= vab_hdr->vs) ?
+                     SsUtGetVagAddr(current_audio.vab_id, atr->vag) >> 3 : 0;
+        tone->pitch = SsPitchFromNote(atr->center, 0, atr->center, atr->shift);
+        tone->adsr1 = atr->adsr1;
+        tone->adsr2 = atr->adsr2;
+        tone->center = atr->center;
+        tone->reverb = atr->mode != 0;
+        tone->pbmin = atr->pbmin;
+        tone->pbmax = atr->pbmax;
+        
+        vol = atr->vol * prog_atr->mvol / 127 * vab_hdr->mvol / 127;
+        pan = atr->pan + prog_atr->mpan - 64;
+        if (pan < 0) pan = 0;
+        if (pan > 127) pan = 127;
+        left = (pan <= 64) ? 127 : (127 * (127 - pan)) / 63;
+        right = (pan >= 64) ? 127 : (127 * pan) / 64;
+        tone->vol_l = vol * left / 127 * SPU_VOLUME_MAX / 127;
+        tone->vol_r = vol * right / 127 * SPU_VOLUME_MAX / 127;
+    }
 }
 
-void pauseSequence(void)
+// Tones of a program that play a note of the current soundbank (bit per tone)
+u_short drvNoteTones(int prog, int note)
 {
-    if (is_playing && current_audio.seq_id >= 0 && !is_paused) {
-        SsSeqPause(current_audio.seq_id);
-        is_paused = 1;
-    } else if (is_playing && current_audio.seq_id >= 0 && is_paused) {
-        SsSeqReplay(current_audio.seq_id);
-        is_paused = 0;
+    if (drv_vab != current_audio.vab_id) drvBuild();
+    if (drv_vab < 0) return 0;
+    return drv_note_tones[prog][note];
+}
+
+// Pitch register for note with pitch bend (0-127, 64 = none): the center
+// pitch scaled in 1/128 semitone steps, between semitones linearly
+u_short drvPitch(DrvTone* tone, int note, int bend)
+{
+    int fine = (note - tone->center) * 128;
+    int octave, semi, step;
+    u_long ratio, pitch;
+    
+    if (bend > 64) {
+        fine += (bend - 64) * tone->pbmax * 128 / 63;
+    } else if (bend < 64) {
+        fine -= (64 - bend) * tone->pbmin * 128 / 64;
     }
+    octave = (fine + 1536 * 24) / 1536 - 24;  // Rounded down for negative offsets
+    step = fine - octave * 1536;
+    semi = step >> 7;
+    ratio = drv_semitones[semi] + (((drv_semitones[semi + 1] - drv_semitones[semi]) * (step & 127)) >> 7);
+    pitch = (tone->pitch * ratio) >> 16;
+    
+    if (octave > 14) return SPU_PITCH_MAX;
+    if (octave < -16) return 0;
+    pitch = octave >= 0 ? pitch << octave : pitch >> -octave;
+    return pitch > SPU_PITCH_MAX ? SPU_PITCH_MAX : pitch;
 }
 
-const char* getReverbTypeName(short type)
+// Set up voice for a tone of the current soundbank and queue its key-on for
+// drvCommit. voll/volr 0-127 scale the tone's volumes
+void drvKeyOn(int voice, int prog, int tone, int note, int voll, int volr, int bend)
 {
-    switch (type) {
-        case 0: return "OFF";
-        case 1: return "ROOM";
-        case 2: return "STUDIO_A";
-        case 3: return "STUDIO_B";
-        case 4: return "STUDIO_C";
-        case 5: return "HALL";
-        case 6: return "SPACE";
-        case 7: return "ECHO";
-        case 8: return "DELAY";
-        case 9: return "PIPE";
-        default: return "UNKNOWN";
+    DrvTone* entry;
+    u_long bit = 1 << voice;
+    
+    if (drv_vab < 0 || drv_vab != current_audio.vab_id || vab_prog_block[prog] < 0) return;
+    entry = &drv_tones[vab_prog_block[prog] * 16 + tone];
+    if (entry->addr == 0) return;
+    
+    SPU_VOICE_REG(voice, SPU_VOICE_VOL_L) = entry->vol_l * voll / 127;
+    SPU_VOICE_REG(voice, SPU_VOICE_VOL_R) = entry->vol_r * volr / 127;
+    SPU_VOICE_REG(voice, SPU_VOICE_PITCH) = drvPitch(entry, note, bend);
+    SPU_VOICE_REG(voice, SPU_VOICE_ADDR) = entry->addr;
+    SPU_VOICE_REG(voice, SPU_VOICE_ADSR1) = entry->adsr1;
+    SPU_VOICE_REG(voice, SPU_VOICE_ADSR2) = entry->adsr2;
+    if (entry->reverb) {
+        drv_eon |= bit;
+    } else {
+        drv_eon &= ~bit;
     }
+    
+    // A key-on restarts the envelope, so a pending key-off is dropped
+    drv_kon |= bit;
+    drv_koff &= ~bit;
+    drv_koff_next &= ~bit;
 }
 
-void adjustMenuValue(int direction, int amount)
+// Queue a key-off. A voice keyed on in this tick gets it at the next commit,
+// so the note still starts
+void drvKeyOff(int voice)
 {
-    // direction: -1 for decrease, 1 for increase
-    // amount: how much to adjust by
+    u_long bit = 1 << voice;
     
-    switch (menu_cursor) {
-        case MENU_TEMPO:
-            current_tempo += (direction * amount);
-            if (current_tempo < 30) current_tempo = 30;
-            if (current_tempo > 240) current_tempo = 240;
-            tempo_changed = 1;  // Mark as changed
-            if (is_playing && current_audio.seq_id >= 0) {
-                if (direction > 0) {
-                    SsSeqSetAccelerando(current_audio.seq_id, current_tempo, 120);
-                } else {
-                    SsSeqSetRitardando(current_audio.seq_id, current_tempo, 120);
-                }
-            }
-            break;
-            
-        case MENU_REV_TYPE:
-            reverb_type += direction;
-            if (reverb_type < 0) reverb_type = 0;
-            if (reverb_type > 9) reverb_type = 9;
-            SsUtSetReverbType(reverb_type);
-            // Reapply reverb depth when changing type
-            SsUtSetReverbDepth(reverb_depth_left, reverb_depth_right);
-            break;
-            
-        case MENU_REV_DEPTH:
-            reverb_depth_left += (direction * amount);
-            reverb_depth_right += (direction * amount);
-            if (reverb_depth_left < 0) {
-                reverb_depth_left = 0;
-                reverb_depth_right = 0;
-            }
-            if (reverb_depth_left > 127) {
-                reverb_depth_left = 127;
-                reverb_depth_right = 127;
-            }
-            SsUtSetReverbDepth(reverb_depth_left, reverb_depth_right);
-            break;
-            
-        case MENU_REV_DELAY:
-            reverb_delay += (direction * amount);
-            if (reverb_delay < 0) reverb_delay = 0;
-            if (reverb_delay > 127) reverb_delay = 127;
-            SsUtSetReverbDelay(reverb_delay);
-            break;
-            
-        case MENU_REV_FEEDBACK:
-            reverb_feedback += (direction * amount);
-            if (reverb_feedback < 0) reverb_feedback = 0;
-            if (reverb_feedback > 127) reverb_feedback = 127;
-            SsUtSetReverbFeedback(reverb_feedback);
-            break;
+    if (drv_kon & bit) {
+        drv_koff_next |= bit;
+    } else {
+        drv_koff |= bit;
     }
 }
 
-void toggleMinMax(void)
+// Change the volume of a sounding voice (voll/volr 0-127 scale its tone's)
+void drvSetVolume(int voice, int voll, int volr)
 {
-    switch (menu_cursor) {
+    DrvTone* entry;
+    int block = vab_prog_block[seq_voices[voice].program];
+    
+    if (drv_vab < 0 || block < 0) return;
+    entry = &drv_tones[block * 16 + seq_voices[voice].tone];
+    SPU_VOICE_REG(voice, SPU_VOICE_VOL_L) = entry->vol_l * voll / 127;
+    SPU_VOICE_REG(voice, SPU_VOICE_VOL_R) = entry->vol_r * volr / 127;
+}
+
+// Bend the pitch of a sounding voice
+void drvSetBend(int voice, int bend)
+{
+    int block = vab_prog_block[seq_voices[voice].program];
+    
+    if (drv_vab < 0 || block < 0) return;
+    SPU_VOICE_REG(voice, SPU_VOICE_PITCH) = drvPitch(&drv_tones[block * 16 + seq_voices[voice].tone],
+                                                     seq_voices[voice].note, bend);
+}
+
+// Write the tick's key-offs and key-ons, one mask write each, so notes that
+// start together start on the same sample. Called at the end of every sound
+// tick, and by the UI inside a critical section
+void drvCommit(void)
+{
+    if (drv_eon != drv_eon_written) {
+        SPU_EON_LO = drv_eon;
+        SPU_EON_HI = drv_eon >> 16;
+        drv_eon_written = drv_eon;
+    }
+    if (drv_koff) {
+        SPU_KOFF_LO = drv_koff;
+        SPU_KOFF_HI = drv_koff >> 16;
+    }
+    if (drv_kon) {
+        SPU_KON_LO = drv_kon;
+        SPU_KON_HI = drv_kon >> 16;
+        drv_kon_writes++;
+        while (drv_kon) {
+            drv_keyons += drv_kon & 1;
+            drv_kon >>= 1;
+        }
+    }
+    drv_koff = drv_koff_next;
+    drv_koff_next = 0;
+}
+
+void readSpuVoices(void)
+{
+    int v;
+    int sounding = 0;
+    
+    // One pass over the voice registers, no library calls per voice
+    for (v = 0; v < SPU_NUM_VOICES; v++) {
+        spu_snapshot.vol_l[v] = SPU_VOICE_REG(v, SPU_VOICE_VOL_L);
+        spu_snapshot.vol_r[v] = SPU_VOICE_REG(v, SPU_VOICE_VOL_R);
+        spu_snapshot.pitch[v] = SPU_VOICE_REG(v, SPU_VOICE_PITCH);
+        spu_snapshot.env[v] = SPU_VOICE_REG(v, SPU_VOICE_ENV);
+    }
+    spu_snapshot.endx = SPU_ENDX_LO | ((u_long)SPU_ENDX_HI << 16);
+    
+    for (v = 0; v < SPU_NUM_VOICES; v++) {
+        if (spu_snapshot.env[v] == 0) {
+            spu_snapshot.release_frames[v] = 0;
+            continue;
+        }
+        sounding++;
+        if (voice_state[v] == VOICE_RELEASED) {
+            if (spu_snapshot.release_frames[v] < 9999) spu_snapshot.release_frames[v]++;
+        } else {
+            spu_snapshot.release_frames[v] = 0;
+        }
+    }
+    spu_snapshot.sounding = sounding;
+    if (sounding > spu_snapshot.sounding_peak) spu_snapshot.sounding_peak = sounding;
+}
+
+// ====================
+// Native Sequencer
+// ====================
+
+void indexVabPrograms(void)
+{
+    vhToneBlocks(current_audio.vh_data, vab_prog_block);
+}
+
+// Tone attributes are stored in the VH as one block of 16 per program that
+// has tones, in program order. blocks gets each program's block, -1 if none
+void vhToneBlocks(u_char* vh, short* blocks)
+{
+    VabHdr* vab_hdr = (VabHdr*)vh;
+    ProgAtr* progs = (ProgAtr*)(vh + sizeof(VabHdr));
+    int i;
+    int block = 0;
+    
+    for (i = 0; i < 128; i++) {
+        if (progs[i].tones > 0 && block < vab_hdr->ps) {
+            blocks[i] = block++;
+        } else {
+            blocks[i] = -1;
+        }
+    }
+}
+
+static void seqUpdateStep(void)
+{
+    SeqPlayer* p = &seq_player;
+    unsigned long long inc = (unsigned long long)p->song->resolution * 1000000 * p->scale_num;
+    unsigned long long cost = (unsigned long long)p->tempo * SEQ_CLOCK_HZ * p->scale_den;
+    u_int frac;
+    
+    // Keep the fractional tick across the change (to 1/65536 tick), the new
+    // rate applies from the next interrupt
+    if (p->tick_cost != 0 && p->tick_acc != 0) {
+        frac = (u_int)((p->tick_acc << 16) / p->tick_cost);
+        p->tick_acc = (cost * frac) >> 16;
+    }
+    
+    // Split the per-interrupt increment once, so the interrupt only adds
+    p->tick_cost = cost;
+    p->tick_whole = (u_int)(inc / cost);
+    p->tick_rem = inc - (unsigned long long)p->tick_whole * cost;
+}
+
+static void seqVoiceVolume(int channel, int velocity, short* voll, short* volr)
+{
+    int vol = (velocity * seq_player.chan.volume[channel]) / 127;
+    int pan = seq_player.chan.pan[channel];
+    
+    *voll = (pan <= 64) ? vol : (vol * (127 - pan)) / 63;
+    *volr = (pan >= 64) ? vol : (vol * pan) / 64;
+}
+
+static void seqNoteOn(int channel, int note, int velocity)
+{
+    int prog = seq_player.chan.program[channel];
+    int block = vab_prog_block[prog];
+    VagAtr* tones;
+    u_long mask;
+    short voll, volr;
+    short voice;
+    int t;
+    
+    if (block < 0 || drv_vab != current_audio.vab_id) return;
+    
+    // Priorities straight from the VH (libsnd edits it in place)
+    tones = (VagAtr*)(current_audio.vh_data + sizeof(VabHdr) + 128 * sizeof(ProgAtr)) + block * 16;
+    seqVoiceVolume(channel, velocity, &voll, &volr);
+    
+    // Every tone whose range covers the note plays (layered tones)
+    for (mask = drv_note_tones[prog][note]; mask != 0; mask &= mask - 1) {
+        t = lowestBit(mask);
+        voice = voiceAlloc(tones[t].prior);
+        if (voice >= 0) {
+            drvKeyOn(voice, prog, t, note, voll, volr, seq_player.chan.bend[channel]);
+            seq_voices[voice].channel = channel;
+            seq_voices[voice].note = note;
+            seq_voices[voice].program = prog;
+            seq_voices[voice].tone = t;
+        }
+    }
+}
+
+static void seqNoteOff(int channel, int note)
+{
+    int v;
+    
+    for (v = 0; v < SPU_NUM_VOICES; v++) {
+        if (seq_voices[v].channel == channel && seq_voices[v].note == note) {
+            drvKeyOff(v);
+            voiceRelease(v);
+            seq_voices[v].channel = -1;
+        }
+    }
+}
+
+static void seqAllNotesOff(void)
+{
+    int v;
+    
+    for (v = 0; v < SPU_NUM_VOICES; v++) {
+        if (seq_voices[v].channel >= 0) {
+            drvKeyOff(v);
+            voiceRelease(v);
+            seq_voices[v].channel = -1;
+        }
+    }
+}
+
+static void seqControl(SeqEvent* ev)
+{
+    int channel = ev->channel;
+    short voll, volr;
+    int v;
+    
+    if (ev->data1 != SEQ_CC_VOLUME && ev->data1 != SEQ_CC_PAN) return;
+    seqApplyEvent(&seq_player.chan, &seq_player.tempo, ev);
+    
+    // Apply to notes already sounding on this channel
+    seqVoiceVolume(channel, 127, &voll, &volr);
+    for (v = 0; v < SPU_NUM_VOICES; v++) {
+        if (seq_voices[v].channel == channel) {
+            drvSetVolume(v, voll, volr);
+        }
+    }
+}
+
+static void seqPitchBend(SeqEvent* ev)
+{
+    int channel = ev->channel;
+    int v;
+    
+    seqApplyEvent(&seq_player.chan, &seq_player.tempo, ev);
+    for (v = 0; v < SPU_NUM_VOICES; v++) {
+        if (seq_voices[v].channel == channel) {
+            drvSetBend(v, ev->data1);
+        }
+    }
+}
+
+static void seqDispatch(SeqEvent* ev)
+{
+    switch (ev->type) {
+        case SEQ_EV_NOTE_ON:
+            seqNoteOn(ev->channel, ev->data1, ev->data2);
+            break;
+        case SEQ_EV_NOTE_OFF:
+            seqNoteOff(ev->channel, ev->data1);
+            break;
+        case SEQ_EV_PROGRAM:
+            seqApplyEvent(&seq_player.chan, &seq_player.tempo, ev);
+            break;
+        case SEQ_EV_CONTROL:
+            seqControl(ev);
+            break;
+        case SEQ_EV_PITCH_BEND:
+            seqPitchBend(ev);
+            break;
+        case SEQ_EV_TEMPO:
+            seqApplyEvent(&seq_player.chan, &seq_player.tempo, ev);
+            seqUpdateStep();
+            break;
+    }
+}
+
+void seqPlayerTick(void)
+{
+    SeqPlayer* p = &seq_player;
+    SeqEvent* ev;
+    
+    if (!p->active) return;
+    
+    p->tick += p->tick_whole;
+    p->tick_acc += p->tick_rem;
+    if (p->tick_acc >= p->tick_cost) {
+        p->tick_acc -= p->tick_cost;
+        p->tick++;
+    }
+    
+    while (1) {
+        if (p->cursor >= p->song->loop_end) {
+            // Loop end marker or end of track: wrap to the loop start (infinite
+            // loop). The marker ticks, not those of the events after them, keep
+            // the gaps around the markers
+            if (p->tick < p->song->loop_end_tick) break;
+            seqAllNotesOff();
+            if (p->song->loop_end_tick <= p->song->loop_start_tick) {
+                p->active = 0;
+                break;
+            }
+            p->tick = p->song->loop_start_tick + (p->tick - p->song->loop_end_tick);
+            p->cursor = p->song->loop_start;
+            continue;
+        }
+        
+        ev = &p->song->events[p->cursor];
+        if (ev->tick > p->tick) break;
+        p->cursor++;
+        seqDispatch(ev);
+    }
+}
+
+void seqPlayerStart(SeqSong* song)
+{
+    EnterCriticalSection();
+    
+    seqAllNotesOff();
+    seq_player.song = song;
+    seq_player.cursor = 0;
+    seq_player.tick = 0;
+    seq_player.tick_acc = 0;
+    seq_player.tempo = song->tempo;
+    seqResetChannels(&seq_player.chan);
+    seqUpdateStep();
+    seq_player.active = 1;
+    
+    ExitCriticalSection();
+}
+
+void seqPlayerStop(void)
+{
+    EnterCriticalSection();
+    seq_player.active = 0;
+    seqAllNotesOff();
+    ExitCriticalSection();
+}
+
+void seqPlayerPause(int pause)
+{
+    EnterCriticalSection();
+    if (pause) {
+        seq_player.active = 0;
+        seqAllNotesOff();
+    } else if (seq_player.song != NULL) {
+        seq_player.active = 1;
+    }
+    ExitCriticalSection();
+}
+
+void seqPlayerSeek(u_int tick)
+{
+    SeqPlayer* p = &seq_player;
+    SeqCheckpoint* cp;
+    SeqEvent* ev;
+    int k;
+    
+    if (p->song == NULL || p->song != seq_index_song || seq_num_checkpoints == 0) return;
+    if (tick > p->song->end_tick) tick = p->song->end_tick;
+    
+    EnterCriticalSection();
+    
+    seqAllNotesOff();
+    
+    // Checkpoints are evenly spaced, so the nearest one is a division away
+    k = tick / seq_checkpoint_interval;
+    if (k >= seq_num_checkpoints) k = seq_num_checkpoints - 1;
+    cp = &seq_checkpoints[k];
+    
+    p->chan = cp->chan;
+    p->tempo = cp->tempo;
+    p->cursor = cp->cursor;
+    
+    // Fast-apply controller events up to the target, notes are skipped
+    while (p->cursor < p->song->loop_end) {
+        ev = &p->song->events[p->cursor];
+        if (ev->tick >= tick) break;
+        seqApplyEvent(&p->chan, &p->tempo, ev);
+        p->cursor++;
+    }
+    
+    p->tick = tick;
+    p->tick_acc = 0;
+    seqUpdateStep();
+    
+    ExitCriticalSection();
+}
+
+void seqPlayerSetTempoScale(long num, long den)
+{
+    // Scales every tempo of the map, so tempo changes in the song are kept
+    EnterCriticalSection();
+    seq_player.scale_num = num;
+    seq_player.scale_den = den;
+    if (seq_player.song != NULL) {
+        seqUpdateStep();
+    }
+    ExitCriticalSection();
+}
+
+void resetTempo(void)
+{
+    // Menu tempo starts at the sequence's real tempo (header tempo)
+    if (current_audio.song != NULL && current_audio.song->tempo > 0) {
+        song_tempo = (60000000 + current_audio.song->tempo / 2) / current_audio.song->tempo;
+    } else {
+        song_tempo = 120;
+    }
+    current_tempo = song_tempo;
+    tempo_changed = 0;
+    seqPlayerSetTempoScale(1, 1);
+}
+
+// First archive entry of a type (background image, sample pool)
+PakEntry* pakFirst(u_char* pak, int type)
+{
+    PakEntry* entry;
+    int count = pakCount(pak);
+    int i;
+    
+    for (i = 0; i < count; i++) {
+        entry = pakEntry(pak, i);
+        if (entry->type == type) return entry;
+    }
+    return NULL;
+}
+
+// A file damaged on the way to the console (serial upload) fails its hash.
+// Disc files are checked when they are read (SEQs by seqLoad, VBs and the
+// pool as they go to the SPU)
+int pakCheck(u_char* pak, PakEntry* entry)
+{
+#if CD_ASSETS
+    if (pak != ASSET_PAK) return 1;
+#endif
+    if (pakHash(pak + entry->offset, entry->packed, PAK_HASH_INIT) == entry->hash) return 1;
+    pak_bad_files++;
+    return 0;
+}
+
+void listFile(FileEntry* file, u_char* pak, PakEntry* entry)
+{
+    sprintf(file->name, "%.31s", entry->name);
+    file->data = pak + entry->offset;
+    file->size = entry->size;
+    file->type = entry->type;
+    file->flags = entry->flags;
+    file->entry = entry;
+    file->hot = 0;
+    file->hash = entry->hash;
+#if CD_ASSETS
+    if (pak != ASSET_PAK) file->data = NULL;
+#endif
+}
+
+void loadAudioFiles(void)
+{
+    int i;
+    PakEntry* entry;
+    char vb_name[PAK_NAME_SIZE + 4];
+    char* dot;
+    u_char* data;
+    int used = 0;
+    int count;
+    
+#if CD_ASSETS
+    cdOpenDisc();
+#endif
+    
+    // SEQ files in archive order
+    count = pakCount(STREAM_PAK);
+    for (i = 0; i < count && num_seq_files < MAX_SEQ_FILES; i++) {
+        entry = pakEntry(STREAM_PAK, i);
+        if (entry->type != PAK_SEQ || !pakCheck(STREAM_PAK, entry)) continue;
+        listFile(&seq_files[num_seq_files++], STREAM_PAK, entry);
+    }
+    
+    // VH files, always in the exe since libsnd reads an open VH in place
+    count = pakCount(ASSET_PAK);
+    for (i = 0; i < count && num_vh_files < MAX_VH_FILES; i++) {
+        entry = pakEntry(ASSET_PAK, i);
+        if (entry->type != PAK_VH || !pakCheck(ASSET_PAK, entry)) continue;
+        listFile(&vh_files[num_vh_files], ASSET_PAK, entry);
+        
+        // VB with the same name
+        sprintf(vb_name, "%s", entry->name);
+        dot = strrchr(vb_name, '.');
+        if (dot) *dot = 0;
+        strcat(vb_name, ".vb");
+        entry = pakFind(STREAM_PAK, vb_name, PAK_VB);
+        if (entry && !pakCheck(STREAM_PAK, entry)) entry = NULL;
+#if !LZ_ASSETS
+        if (entry && (entry->flags & PAK_FLAG_LZ)) entry = NULL;  // Packed with -z, built without
+#endif
+        vb_files[num_vh_files] = entry ? STREAM_PAK + entry->offset : NULL;
+        vb_flags[num_vh_files] = entry ? entry->flags : 0;
+#if CD_ASSETS
+        vb_files[num_vh_files] = NULL;
+        vb_sectors[num_vh_files] = entry ? disc_sector + entry->offset / CD_SECTOR : 0;
+        vb_hashes[num_vh_files] = entry ? entry->hash : 0;
+#endif
+#if !VB_POOL
+        if (!entry) continue;
+#endif
+        num_vh_files++;
+    }
+    
+#if !CD_ASSETS
+    // Decode every SEQ file once into the shared event pool. Compressed ones
+    // are expanded first, only their events are kept
+    for (i = 0; i < num_seq_files; i++) {
+        data = seq_files[i].data;
+        count = 0;
+        if (seq_files[i].flags & PAK_FLAG_LZ) {
+#if LZ_ASSETS
+            data = (u_char*)seq_unpack;
+            if (seq_files[i].size > SEQ_UNPACK_SIZE || pakUnpack(seq_files[i].data, seq_files[i].size, data) < 0) {
+                count = -1;
+            }
+#else
+            count = -1;
+#endif
+        }
+        if (count == 0) {
+            count = seqDecode(data, seq_files[i].size, &seq_event_pool[used], SEQ_EVENT_POOL - used, &seq_songs[i]);
+        }
+        if (count < 0) {
+            seq_songs[i].num_events = 0;  // Invalid or does not fit, cannot be played
+            continue;
+        }
+        used += count;
+    }
+    seq_pool_static = used;
+#endif
+    num_seq_static = num_seq_files;
+    num_vh_static = num_vh_files;
+    
+    // No sequencer voices or audition notes in use
+    for (i = 0; i < SPU_NUM_VOICES; i++) {
+        seq_voices[i].channel = -1;
+        voice_audition[i] = -1;
+    }
+    for (i = 0; i < AUDITION_SLOTS; i++) {
+        audition_slots[i].voice = -1;
+    }
+    
+    // Initialize current audio structure
+    current_audio.vab_id = -1;
+    current_audio.song = NULL;
+    
+    // No soundbank in SPU RAM
+    for (i = 0; i < VAB_CACHE_SLOTS; i++) {
+        vab_cache[i].vab_id = -1;
+    }
+#if VB_POOL
+    vbPoolUpload();
+#endif
+}
+
+// Decoded sequence of seq_files[i], NULL if it cannot be played. Disc and
+// received SEQs are decoded now, replacing the previous one in the event pool
+SeqSong* seqLoad(int i)
+{
+    FileEntry* file = &seq_files[i];
+    u_char* data = file->data;
+    
+#if !CD_ASSETS
+    if (!file->hot) return &seq_songs[i];  // Decoded at startup
+#endif
+    if (seq_loaded == i) return &seq_songs[i];
+    
+    seqPlayerStop();
+    if (seq_loaded >= 0) seq_songs[seq_loaded].num_events = 0;
+    seq_loaded = -1;
+    
+#if CD_ASSETS
+    if (!data) {
+        data = (u_char*)seq_unpack;
+        if (file->size > SEQ_UNPACK_SIZE || (file->flags & PAK_FLAG_LZ)) return NULL;
+        if (!cdReadWait(disc_sector + file->entry->offset / CD_SECTOR, data, file->size) ||
+            pakHash(data, file->size, PAK_HASH_INIT) != file->entry->hash) {
+            return NULL;
+        }
+    }
+#endif
+    if (seqDecode(data, file->size, &seq_event_pool[seq_pool_static], SEQ_EVENT_POOL - seq_pool_static,
+                  &seq_songs[i]) < 0) {
+        seq_songs[i].num_events = 0;
+        return NULL;
+    }
+    seq_loaded = i;
+    return &seq_songs[i];
+}
+
+#if CD_ASSETS
+// Start reading size bytes (rounded up to whole sectors, the buffer needs room
+// for them) from a disc sector. CdReadSync tells when it is done. 0 on failure
+int cdReadStart(u_long sector, void* buffer, u_long size)
+{
+    CdlLOC loc;
+    
+    CdIntToPos(sector, &loc);
+    if (!CdControl(CdlSetloc, (u_char*)&loc, 0)) return 0;
+    return CdRead((size + CD_SECTOR - 1) / CD_SECTOR, (u_long*)buffer, CdlModeSpeed);
+}
+
+// Read and wait for it, retrying a few times. 0 on failure
+int cdReadWait(u_long sector, void* buffer, u_long size)
+{
+    int i;
+    
+    for (i = 0; i < 3; i++) {
+        if (cdReadStart(sector, buffer, size) && CdReadSync(0, 0) == 0) return 1;
+        cd_retries++;
+    }
+    return 0;
+}
+
+// Find DISC.PAK and read its index. Without it the SEQ list stays empty
+void cdOpenDisc(void)
+{
+    CdlFILE file;
+    PakHeader* header = (PakHeader*)disc_index;
+    
+    CdInit();
+    if (!CdSearchFile(&file, "\\DISC.PAK;1")) return;
+    disc_sector = CdPosToInt(&file.pos);
+    if (!cdReadWait(disc_sector, disc_index, sizeof(disc_index)) ||
+        sizeof(PakHeader) + header->count * sizeof(PakEntry) > sizeof(disc_index)) {
+        header->magic = 0;  // Unreadable, or more files than this exe was built for
+    }
+}
+#endif
+
+// Soundbank cache
+
+u_long vabBodySize(u_char* vh)
+{
+    VabHdr* vab_hdr = (VabHdr*)vh;
+    u_short* vag_sizes = (u_short*)(vh + sizeof(VabHdr) + 128 * sizeof(ProgAtr) + vab_hdr->ps * 16 * sizeof(VagAtr));
+    u_long size = 0;
+    int i;
+    
+    // Entry 0 is unused, sizes are in units of 8 bytes
+    for (i = 1; i <= vab_hdr->vs; i++) {
+        size += (u_long)vag_sizes[i] << 3;
+    }
+    return size;
+}
+
+// Lowest free SPU RAM address with room for size bytes, 0 if none
+u_long spuRamFind(u_long size)
+{
+#if VB_POOL
+    u_long addr = SPU_RAM_BASE + ((VB_POOL_SIZE + 7) & ~7);  // The pool stays at the base
+#else
+    u_long addr = SPU_RAM_BASE;
+#endif
+    u_long next;
+    int i, moved;
+    
+    // Walk up past every resident VB that overlaps the candidate range
+    do {
+        moved = 0;
+        for (i = 0; i < VAB_CACHE_SLOTS; i++) {
+            if (vab_cache[i].vab_id < 0) continue;
+            next = vab_cache[i].addr + vab_cache[i].size;
+            if (vab_cache[i].addr < addr + size && next > addr) {
+                addr = (next + 7) & ~7;
+                moved = 1;
+            }
+        }
+    } while (moved);
+    
+    return addr + size <= SPU_RAM_END ? addr : 0;
+}
+
+void vabCacheEvict(int slot)
+{
+    SsVabClose(vab_cache[slot].vab_id);
+    if (current_audio.vab_id == vab_cache[slot].vab_id) {
+        current_audio.vab_id = -1;
+    }
+    if (drv_vab == vab_cache[slot].vab_id) {
+        drv_vab = -1;  // The id can come back with other VAG addresses
+    }
+    if (attr_vab == vab_cache[slot].vab_id) {
+        attr_vab = -1;
+    }
+    vab_cache[slot].vab_id = -1;
+    vab_cache_evictions++;
+}
+
+// Slot holding vh_files[vh], -1 if it is not resident
+int vabCacheFind(int vh)
+{
+    int i;
+    
+    for (i = 0; i < VAB_CACHE_SLOTS; i++) {
+        if (vab_cache[i].vab_id >= 0 && vab_cache[i].vh == vh) return i;
+    }
+    return -1;
+}
+
+// VAB id of vh_files[vh], uploading its VB if it is not resident. Blocks
+// until the upload is done. Returns -1 on failure
+int vabCacheOpen(int vh)
+{
+    int vab_id = vabCacheBegin(vh);
+    
+    while (vab_id == VAB_LOADING) {
+        vab_id = vabCacheStep();
+    }
+    return vab_id;
+}
+
+// VAB id of vh_files[vh] if it is resident. Otherwise least recently used
+// soundbanks are closed until it fits, the VH is opened and VAB_LOADING is
+// returned: vabCacheStep() then sends the VB a chunk at a time. -1 on failure
+int vabCacheBegin(int vh)
+{
+    int pooled = VB_POOL && !vh_files[vh].hot;  // Samples are already in the pool
+    u_long size = pooled ? 0 : vabBodySize(vh_files[vh].data);
+    u_long addr;
+    int slot;
+    int i, lru;
+    
+    // One upload at a time
+    if (vab_load_slot >= 0) vabCacheCancel();
+    
+    slot = vabCacheFind(vh);
+    if (slot >= 0) {
+        vab_cache[slot].last_used = ++vab_cache_serial;
+        vab_cache_hits++;
+        return vab_cache[slot].vab_id;
+    }
+    
+    // Edits saved on the memory card go into the VH before libsnd reads it
+    editApply(vh);
+    
+    if (size > SPU_RAM_END - SPU_RAM_BASE) return -1;
+    
+    for (;;) {
+        // Need both a VAB id and a free range
+        slot = -1;
+        for (i = 0; i < VAB_CACHE_SLOTS; i++) {
+            if (vab_cache[i].vab_id < 0) slot = i;
+        }
+        addr = slot >= 0 ? spuRamFind(size) : 0;
+        if (addr) break;
+        
+        lru = -1;
+        for (i = 0; i < VAB_CACHE_SLOTS; i++) {
+            if (vab_cache[i].vab_id < 0) continue;
+            if (lru < 0 || vab_cache[i].last_used < vab_cache[lru].last_used) lru = i;
+        }
+        vabCacheEvict(lru);
+    }
+    
+#if VB_POOL
+    if (pooled) {
+        vab_cache[slot].vab_id = vbPoolOpen(vh);
+    } else
+#endif
+    {
+        // The VB goes where the cache put it instead of where libsnd's SpuMalloc would
+        vab_cache[slot].vab_id = SsVabOpenHeadSticky(vh_files[vh].data, -1, addr);
+    }
+    if (vab_cache[slot].vab_id < 0) {
+        return -1;
+    }
+    
+    vab_cache[slot].vh = vh;
+    vab_cache[slot].addr = addr;
+    vab_cache[slot].size = size;
+    vab_cache[slot].sent = 0;
+    vab_cache[slot].next = vb_files[vh];
+    vab_cache[slot].last_used = ++vab_cache_serial;
+    if (pooled) {
+        vab_cache_loads++;
+        return vab_cache[slot].vab_id;
+    }
+#if CD_ASSETS
+    // First chunk of a VB on the disc, the rest are read by vabCacheStep
+    if (!vb_files[vh]) {
+        cd_buffer = 0;
+        cd_ready = 0;
+        cd_hash = PAK_HASH_INIT;
+        cd_reading = cdReadStart(vb_sectors[vh], cd_buffers[0], size < VAB_CHUNK ? size : VAB_CHUNK);
+    }
+#endif
+    vab_load_slot = slot;
+    return VAB_LOADING;
+}
+
+#if VB_POOL
+// Every VAG of every bank, once, at the bottom of SPU RAM
+void vbPoolUpload(void)
+{
+    PakEntry* entry = pakFirst(STREAM_PAK, PAK_POOL);
+#if LZ_ASSETS
+    const u_char* block;
+#endif
+    u_long addr = SPU_RAM_BASE;
+    int length;
+#if CD_ASSETS
+    u_int hash = PAK_HASH_INIT;
+#endif
+    
+    // A damaged pool is left out, banks then only open from a VB of their own
+    if (!entry || !pakCheck(STREAM_PAK, entry)) return;
+    SpuSetTransferMode(SPU_TRANSFER_BY_DMA);
+#if CD_ASSETS
+    // From the disc through a chunk buffer, checked as it is read
+    for (; addr < SPU_RAM_BASE + entry->size; addr += length) {
+        length = SPU_RAM_BASE + entry->size - addr;
+        if (length > VAB_CHUNK) length = VAB_CHUNK;
+        if (!cdReadWait(disc_sector + (entry->offset + addr - SPU_RAM_BASE) / CD_SECTOR, cd_buffers[0], length)) break;
+        hash = pakHash((u_char*)cd_buffers[0], length, hash);
+        SpuSetTransferStartAddr(addr);
+        SpuWrite((u_char*)cd_buffers[0], length);
+        SpuIsTransferCompleted(SPU_TRANSFER_WAIT);
+    }
+    if (addr < SPU_RAM_BASE + entry->size || hash != entry->hash) {
+        pak_bad_files++;
+        return;
+    }
+    vb_pool_ok = 1;
+    return;
+#endif
+    if (!(entry->flags & PAK_FLAG_LZ)) {
+        SpuSetTransferStartAddr(SPU_RAM_BASE);
+        SpuWrite(ASSET_PAK + entry->offset, VB_POOL_SIZE);
+        SpuIsTransferCompleted(SPU_TRANSFER_WAIT);
+        vb_pool_ok = 1;
+        return;
+    }
+    
+#if LZ_ASSETS
+    // One block at a time through pak_block
+    block = ASSET_PAK + entry->offset;
+    while (addr < SPU_RAM_BASE + entry->size) {
+        length = pakUnpackBlock(&block, pak_block);
+        if (length <= 0) break;
+        SpuSetTransferStartAddr(addr);
+        SpuWrite(pak_block, length);
+        SpuIsTransferCompleted(SPU_TRANSFER_WAIT);
+        addr += length;
+    }
+    vb_pool_ok = addr >= SPU_RAM_BASE + entry->size;
+#endif
+}
+
+// Open vh_files[vh] with its VAG addresses pointing into the pool instead of
+// a VB of its own. Returns the VAB id, -1 if the bank is not in the pool
+int vbPoolOpen(int vh)
+{
+    VbPoolBank* bank = NULL;
+    short vab_id;
+    int i;
+    
+    if (!vb_pool_ok) return -1;
+    for (i = 0; i < MAX_VH_FILES; i++) {
+        if (strcmp(vb_pool_banks[i].name, vh_files[vh].name) == 0) bank = &vb_pool_banks[i];
+    }
+    if (!bank) return -1;
+    
+    vab_id = SsVabOpenHeadSticky(vh_files[vh].data, -1, SPU_RAM_BASE);
+    if (vab_id < 0) return -1;
+    
+    // Body is already in SPU RAM, only the VAG addresses differ from a VB layout
+    SsVabFakeBody(vab_id);
+    for (i = 0; i < bank->num_vags; i++) {
+        SsUtSetVagAddr(vab_id, i + 1, SPU_RAM_BASE + bank->offsets[i]);
+    }
+    return vab_id;
+}
+#endif
+
+// Continue the upload started by vabCacheBegin(): starts the next DMA chunk
+// once the previous one is done. Returns the VAB id when the whole VB is in
+// SPU RAM, VAB_LOADING while it is not, -1 if the transfer failed
+int vabCacheStep(void)
+{
+    VabCacheSlot* slot;
+    u_char* data;
+    int chunk;
+#if CD_ASSETS
+    int status;
+#endif
+    
+    if (vab_load_slot < 0) return -1;
+    slot = &vab_cache[vab_load_slot];
+#if CD_ASSETS
+    // The next chunk is read from the disc while the last one goes to the SPU.
+    // A failed read is started again (Circle still cancels)
+    if (!vb_files[slot->vh] && slot->sent < slot->size && !cd_ready) {
+        status = cd_reading ? CdReadSync(1, 0) : -1;
+        if (status > 0) return VAB_LOADING;
+        if (status < 0) {
+            cd_retries++;
+            chunk = slot->size - slot->sent;
+            if (chunk > VAB_CHUNK) chunk = VAB_CHUNK;
+            cd_reading = cdReadStart(vb_sectors[slot->vh] + slot->sent / CD_SECTOR, cd_buffers[cd_buffer], chunk);
+            return VAB_LOADING;
+        }
+        cd_reading = 0;
+        cd_ready = 1;
+    }
+#endif
+    if (SsVabTransCompleted(SS_IMMEDIATE) == 0) return VAB_LOADING;
+    
+    if (slot->sent >= slot->size) {
+        vab_load_slot = -1;
+#if CD_ASSETS
+        // A VB damaged on the disc is not kept
+        if (!vb_files[slot->vh] && cd_hash != vb_hashes[slot->vh]) {
+            pak_bad_files++;
+            SsVabClose(slot->vab_id);
+            slot->vab_id = -1;
+            return -1;
+        }
+#endif
+        vab_cache_loads++;
+        return slot->vab_id;
+    }
+    
+    // A compressed VB is expanded a block per chunk, the previous chunk's DMA
+    // from pak_block has finished by now
+#if CD_ASSETS
+    if (!vb_files[slot->vh]) {
+        chunk = VAB_CHUNK;
+        data = (u_char*)cd_buffers[cd_buffer];
+    } else
+#endif
+#if LZ_ASSETS
+    if (vb_flags[slot->vh] & PAK_FLAG_LZ) {
+        chunk = pakUnpackBlock(&slot->next, pak_block);
+        data = pak_block;
+    } else
+#endif
+    {
+        chunk = VAB_CHUNK;
+        data = vb_files[slot->vh] + slot->sent;
+    }
+    if (chunk > (int)(slot->size - slot->sent)) chunk = slot->size - slot->sent;
+    if (chunk <= 0 || SsVabTransBodyPartly(data, chunk, slot->vab_id) == -1) {
+        SsVabClose(slot->vab_id);
+        slot->vab_id = -1;
+        vab_load_slot = -1;
+        return -1;
+    }
+    slot->sent += chunk;
+#if CD_ASSETS
+    // The other buffer's DMA is done, read the chunk after this one into it
+    if (!vb_files[slot->vh]) {
+        cd_hash = pakHash(data, chunk, cd_hash);
+        cd_buffer ^= 1;
+        cd_ready = 0;
+    }
+    if (!vb_files[slot->vh] && slot->sent < slot->size) {
+        chunk = slot->size - slot->sent;
+        if (chunk > VAB_CHUNK) chunk = VAB_CHUNK;
+        cd_reading = cdReadStart(vb_sectors[slot->vh] + slot->sent / CD_SECTOR, cd_buffers[cd_buffer], chunk);
+    }
+#endif
+    return VAB_LOADING;
+}
+
+// Abandon the running upload, its SPU RAM is free again
+void vabCacheCancel(void)
+{
+    if (vab_load_slot < 0) return;
+    
+    SsVabTransCompleted(SS_WAIT_COMPLETED);  // At most one chunk
+#if CD_ASSETS
+    if (cd_reading) CdReadSync(0, 0);
+    cd_reading = 0;
+    cd_ready = 0;
+#endif
+    SsVabClose(vab_cache[vab_load_slot].vab_id);
+    vab_cache[vab_load_slot].vab_id = -1;
+    vab_load_slot = -1;
+}
+
+// Open the selected soundbank, then enter next. Banks that are not resident
+// upload across frames in STATE_VAB_LOADING, where Circle goes back instead
+void beginBankLoad(UIState next, UIState back)
+{
+    load_next_state = next;
+    load_return_state = back;
+    
+    current_audio.vab_id = vabCacheBegin(selected_vh);
+    if (current_audio.vab_id == VAB_LOADING) {
+        current_audio.vab_id = -1;
+        current_state = STATE_VAB_LOADING;
+    } else if (current_audio.vab_id >= 0) {
+        finishBankLoad();
+    } else {
+        FntPrint("Failed to load VAB!\n");
+    }
+}
+
+void finishBankLoad(void)
+{
+    if (load_next_state == STATE_VAB_PLAYBACK) {
+        // Enable reverb
+        SsUtSetReverbType(reverb_type);
+        SsUtReverbOn();
+        SsUtSetReverbDepth(reverb_depth_left, reverb_depth_right);
+        
+        // Reset VAB mode parameters
+        current_note = 60;  // Middle C
+        current_program = 0;
+        note_playing = 0;
+        menu_cursor = 0;
+    }
+    
+    current_state = load_next_state;
+}
+
+// SPU RAM taken by resident VBs
+u_long vabCacheUsed(void)
+{
+    u_long used = 0;
+    int i;
+    
+    for (i = 0; i < VAB_CACHE_SLOTS; i++) {
+        if (vab_cache[i].vab_id >= 0) used += vab_cache[i].size;
+    }
+    return used;
+}
+
+// Serial hot-load
+
+// SIO interrupt: every received byte goes into the ring
+void sioInterrupt(void)
+{
+    u_int next;
+    u_char c;
+    
+    while (SIO_STAT & SIO_STAT_RX_READY) {
+        c = SIO_DATA;
+        next = (sio_head + 1) & (SIO_RING - 1);
+        if (next == sio_tail) {
+            sio_overruns++;
+            continue;
+        }
+        sio_ring[sio_head] = c;
+        sio_head = next;
+    }
+    if (SIO_STAT & SIO_STAT_OVERRUN) sio_overruns++;
+    SIO_CTRL |= SIO_CTRL_ACK;
+}
+
+void sioOpen(void)
+{
+    EnterCriticalSection();
+    SIO_CTRL = SIO_CTRL_RESET;
+    SIO_MODE = SIO_MODE_8N1;
+    SIO_BAUD = SIO_CLOCK / HOT_BAUD;
+    SIO_CTRL = SIO_CTRL_TX | SIO_CTRL_RX | SIO_CTRL_DTR | SIO_CTRL_RTS | SIO_CTRL_RX_IRQ;
+    sio_head = sio_tail = 0;
+    InterruptCallback(SIO_IRQ, sioInterrupt);
+    ExitCriticalSection();
+}
+
+void sioClose(void)
+{
+    EnterCriticalSection();
+    InterruptCallback(SIO_IRQ, NULL);
+    SIO_CTRL = 0;
+    ExitCriticalSection();
+}
+
+// Next received byte, -1 if the ring is empty
+int sioRead(void)
+{
+    int c;
+    
+    if (sio_tail == sio_head) return -1;
+    c = sio_ring[sio_tail];
+    sio_tail = (sio_tail + 1) & (SIO_RING - 1);
+    return c;
+}
+
+void sioWrite(u_char c)
+{
+    while (!(SIO_STAT & SIO_STAT_TX_READY));
+    SIO_DATA = c;
+}
+
+// Same file name up to the extension (a VH and its VB)
+int hotSameBank(const char* a, const char* b)
+{
+    while (*a && *a != '.' && *a == *b) {
+        a++;
+        b++;
+    }
+    return (*a == 0 || *a == '.') && (*b == 0 || *b == '.');
+}
+
+// Drop everything that points into hot_ram before it changes: banks opened
+// from a received VH (libsnd reads an open VH in place) and the decoded
+// events of a received SEQ. List indices of received files may also move
+void hotForget(void)
+{
+    int i;
+    
+    vabCacheCancel();
+    for (i = 0; i < VAB_CACHE_SLOTS; i++) {
+        if (vab_cache[i].vab_id >= 0 && vab_cache[i].vh >= num_vh_static) vabCacheEvict(i);
+    }
+    if (seq_loaded >= num_seq_static) {
+        seqPlayerStop();
+        seq_songs[seq_loaded].num_events = 0;
+        seq_loaded = -1;
+    }
+    seq_index_song = NULL;
+}
+
+// Remove a received file, the ones after it move down
+void hotRemove(int i)
+{
+    u_long size = (hot_files[i].size + 15) & ~15;
+    u_char* end = (u_char*)hot_ram + hot_used;
+    int j;
+    
+    memmove(hot_files[i].data, hot_files[i].data + size, end - (hot_files[i].data + size));
+    hot_used -= size;
+    for (j = i + 1; j < hot_count; j++) {
+        hot_files[j].data -= size;
+        hot_files[j - 1] = hot_files[j];
+    }
+    hot_count--;
+}
+
+// List the received files after the packed ones. A VH is listed once its
+// VB has been received too
+void hotRefresh(void)
+{
+    HotFile* file;
+    FileEntry* entry;
+    int i, j;
+    
+    num_seq_files = num_seq_static;
+    num_vh_files = num_vh_static;
+    for (i = 0; i < hot_count; i++) {
+        file = &hot_files[i];
+        if (file->type == PAK_SEQ) {
+            seq_songs[num_seq_files].num_events = 0;  // Decoded by seqLoad
+            entry = &seq_files[num_seq_files++];
+        } else if (file->type == PAK_VH) {
+            for (j = 0; j < hot_count; j++) {
+                if (hot_files[j].type == PAK_VB && hotSameBank(hot_files[j].name, file->name)) break;
+            }
+            if (j == hot_count) continue;
+            vb_files[num_vh_files] = hot_files[j].data;
+            vb_flags[num_vh_files] = 0;
+            entry = &vh_files[num_vh_files++];
+        } else {
+            continue;
+        }
+        sprintf(entry->name, "%.31s", file->name);
+        entry->data = file->data;
+        entry->size = file->size;
+        entry->type = file->type;
+        entry->flags = 0;
+        entry->entry = NULL;
+        entry->hot = 1;
+        entry->hash = file->hash;
+    }
+}
+
+// The whole file is in hot_ram after the other received files: list it, and
+// upload a complete soundbank to SPU RAM
+void hotAdd(void)
+{
+    HotFile* file = &hot_files[hot_count++];
+    int i;
+    
+    sprintf(file->name, "%.31s", hot_header.name);
+    file->type = hot_header.type;
+    file->data = (u_char*)hot_ram + hot_used;
+    file->size = hot_header.size;
+    file->hash = hot_header.hash;
+    hot_used += (file->size + 15) & ~15;
+    hotRefresh();
+    
+    sprintf(hot_status, "%.31s received", file->name);
+    if (file->type == PAK_SEQ) return;
+    for (i = num_vh_static; i < num_vh_files; i++) {
+        if (hotSameBank(vh_files[i].name, file->name)) break;
+    }
+    if (i == num_vh_files) {
+        sprintf(hot_status, "%.31s received, needs its %s", file->name, file->type == PAK_VH ? "VB" : "VH");
+    } else if (vabCacheOpen(i) >= 0) {
+        sprintf(hot_status, "%.31s in SPU RAM", vh_files[i].name);
+    } else {
+        sprintf(hot_status, "%.31s does not fit in SPU RAM", vh_files[i].name);
+    }
+}
+
+// Start receiving the file described by a complete header packet
+void hotHeader(void)
+{
+    HotHeader* header = &hot_header;
+    u_long size, freed = 0;
+    int i, old = -1;
+    
+    hot_phase = HOT_PHASE_SYNC;
+    hot_sync = 0;
+    memcpy(header, hot_packet, sizeof(HotHeader));
+    if (pakHash((u_char*)header, sizeof(HotHeader) - 4, PAK_HASH_INIT) != header->check) {
+        hot_retries++;
+        sioWrite(HOT_NAK);
+        return;
+    }
+    header->name[PAK_NAME_SIZE - 1] = 0;
+    
+    // A file sent again replaces the one received before, counting the room
+    // it frees. The old copy stays if the new one is refused
+    for (i = 0; i < hot_count; i++) {
+        if (strcmp(hot_files[i].name, header->name) == 0) {
+            old = i;
+            freed = (hot_files[i].size + 15) & ~15;
+            break;
+        }
+    }
+    
+    size = (header->size + 15) & ~15;
+    if ((header->type != PAK_SEQ && header->type != PAK_VH && header->type != PAK_VB) || header->size == 0 ||
+        (old < 0 && hot_count == HOT_FILES) || size > HOT_RAM_SIZE - hot_used + freed) {
+        sprintf(hot_status, "%.31s refused, no room", header->name);
+        sioWrite(HOT_REFUSE);
+        return;
+    }
+    
+    hotForget();
+    if (old >= 0) hotRemove(old);
+    hotRefresh();
+    
+    hot_received = 0;
+    hot_next_chunk = 0;
+    hot_stalled = 0;
+    hot_phase = HOT_PHASE_CHUNK_HEAD;
+    hot_packet_want = HOT_CHUNK_HEAD;
+    sioWrite(HOT_ACK);
+}
+
+// Store a complete chunk packet if it is the next one
+void hotChunk(void)
+{
+    u_int index = hot_packet[0] | (hot_packet[1] << 8);
+    u_int length = hot_packet[2] | (hot_packet[3] << 8);
+    u_char* tail = hot_packet + HOT_CHUNK_HEAD + length;
+    u_int hash = tail[0] | (tail[1] << 8) | (tail[2] << 16) | ((u_int)tail[3] << 24);
+    u_char* file = (u_char*)hot_ram + hot_used;
+    
+    hot_phase = HOT_PHASE_CHUNK_HEAD;
+    hot_packet_want = HOT_CHUNK_HEAD;
+    if (pakHash(hot_packet, HOT_CHUNK_HEAD + length, PAK_HASH_INIT) != hash) {
+        hot_retries++;
+        sioWrite(HOT_NAK);
+        return;
+    }
+    if (index + 1 == (u_int)hot_next_chunk) {
+        // Already stored, the host missed the reply
+        sioWrite(hot_received == hot_header.size ? HOT_DONE : HOT_ACK);
+        return;
+    }
+    if (index != (u_int)hot_next_chunk || length == 0 || hot_received + length > hot_header.size ||
+        hot_received == hot_header.size) {
+        hot_retries++;
+        sioWrite(HOT_NAK);
+        return;
+    }
+    
+    memcpy(file + hot_received, hot_packet + HOT_CHUNK_HEAD, length);
+    hot_received += length;
+    hot_next_chunk++;
+    hot_stalled = 0;
+    if (hot_received < hot_header.size) {
+        sioWrite(HOT_ACK);
+        return;
+    }
+    
+    if (pakHash(file, hot_header.size, PAK_HASH_INIT) != hot_header.hash) {
+        sprintf(hot_status, "%.31s damaged, send it again", hot_header.name);
+        hot_phase = HOT_PHASE_SYNC;
+        hot_sync = 0;
+        sioWrite(HOT_REFUSE);
+        return;
+    }
+    
+    // Stays in the chunk phase so a last chunk sent again is answered again,
+    // the next header starts a new file
+    hotAdd();
+    sioWrite(HOT_DONE);
+}
+
+void hotByte(u_char c)
+{
+    static const u_long hot_sync_magic = HOT_MAGIC;
+    u_int length;
+    
+    if (hot_phase == HOT_PHASE_SYNC) {
+        hot_sync = (hot_sync >> 8) | ((u_long)c << 24);
+        if (hot_sync == HOT_MAGIC) {
+            memcpy(hot_packet, &hot_sync, 4);
+            hot_packet_size = 4;
+            hot_packet_want = sizeof(HotHeader);
+            hot_phase = HOT_PHASE_HEADER;
+            hot_stalled = 0;
+        }
+        return;
+    }
+    
+    hot_packet[hot_packet_size++] = c;
+    if (hot_phase == HOT_PHASE_CHUNK_HEAD && hot_packet_size == HOT_CHUNK_HEAD) {
+        length = hot_packet[2] | (hot_packet[3] << 8);
+        if (memcmp(hot_packet, &hot_sync_magic, 4) == 0) {
+            // Header sent again (our HOT_ACK was lost), the file starts over
+            hot_packet_want = sizeof(HotHeader);
+            hot_phase = HOT_PHASE_HEADER;
+            return;
+        }
+        if (length > HOT_CHUNK) {
+            // Lost track of the packets: skip what is queued and ask again
+            sio_tail = sio_head;
+            hot_packet_size = 0;
+            hot_retries++;
+            sioWrite(HOT_NAK);
+            return;
+        }
+        hot_packet_want = HOT_CHUNK_HEAD + length + HOT_CHUNK_TAIL;
+        hot_phase = HOT_PHASE_CHUNK;
+    }
+    if (hot_packet_size < hot_packet_want) return;
+    
+    hot_packet_size = 0;
+    if (hot_phase == HOT_PHASE_HEADER) {
+        hotHeader();
+    } else {
+        hotChunk();
+    }
+}
+
+// Handle the bytes received since the last frame
+void hotReceive(void)
+{
+    int c;
+    int got = 0;
+    
+    while ((c = sioRead()) >= 0) {
+        hotByte(c);
+        got = 1;
+    }
+    hot_quiet = got ? 0 : hot_quiet + 1;
+    if (hot_phase == HOT_PHASE_SYNC) return;
+    
+    // A packet cut short is dropped and asked for again, a host that went
+    // away ends the transfer
+    if (hot_packet_size > 0 && hot_quiet == HOT_PACKET_TIMEOUT) {
+        hot_packet_size = 0;
+        if (hot_phase == HOT_PHASE_HEADER) {
+            hot_phase = HOT_PHASE_SYNC;
+            hot_sync = 0;
+        } else {
+            hot_phase = HOT_PHASE_CHUNK_HEAD;
+            hot_packet_want = HOT_CHUNK_HEAD;
+        }
+        hot_retries++;
+        sioWrite(HOT_NAK);
+    }
+    if (++hot_stalled > HOT_TIMEOUT) {
+        if (hot_received < hot_header.size) sprintf(hot_status, "%.31s timed out", hot_header.name);
+        hot_phase = HOT_PHASE_SYNC;
+        hot_sync = 0;
+        hot_packet_size = 0;
+    }
+}
+
+void enterHotLoad(void)
+{
+    seqPlayerStop();
+    hot_phase = HOT_PHASE_SYNC;
+    hot_sync = 0;
+    hot_packet_size = 0;
+    sprintf(hot_status, "Waiting for tools/hotload");
+    sioOpen();
+    current_state = STATE_HOT_LOAD;
+}
+
+void exitHotLoad(void)
+{
+    sioClose();
+    current_state = STATE_SEQ_SELECT;
+    cursor = 0;
+}
+
+void playSequence(void)
+{
+    if (is_playing) {
+        stopSequence();
+    }
+    
+    // Reset tempo to the song tempo
+    resetTempo();
+    
+    // Soundbank is usually still resident from the last time it was used.
+    // Program edits live in the VH itself, so they survive either way
+    if (current_audio.vab_id < 0) {
+        current_audio.vab_id = vabCacheOpen(selected_vh);
+        if (current_audio.vab_id < 0) {
+            FntPrint("Failed to load VAB!\n");
+            return;
+        }
+    }
+    
+    // Sequence was decoded at startup, or read from the disc when it was chosen
+    if (current_audio.song == NULL || current_audio.song->num_events == 0) {
+        FntPrint("Failed to open sequence!\n");
+        return;
+    }
+
+	//Enable reverb
+	SsUtSetReverbType(reverb_type);
+	SsUtReverbOn();
+
+	
+    
+    // Build the seek index and tempo map once per sequence (one checkpoint per bar)
+    if (seq_index_song != current_audio.song) {
+        seq_num_checkpoints = seqBuildCheckpoints(current_audio.song, seqBarTicks(current_audio.song),
+                                                  seq_checkpoints, SEQ_MAX_CHECKPOINTS,
+                                                  &seq_checkpoint_interval);
+        seq_num_tempos = seqBuildTempoMap(current_audio.song, seq_tempo_map, SEQ_MAX_TEMPOS);
+        seq_index_song = current_audio.song;
+    }
+    
+    // Play sequence (infinite loop)
+    drvBuild();
+    voiceResetStats();
+    seqPlayerStart(current_audio.song);
+
+	//Set to default values
+	SsUtSetReverbDepth (reverb_depth_left, reverb_depth_right);
+
+    is_playing = 1;
+}
+
+void stopSequence(void)
+{
+    if (is_playing) {
+        seqPlayerStop();
+        is_playing = 0;
+    }
+    
+    // Keep VAB loaded so program editing works when stopped
+    // VAB will be closed when changing files or in cleanup
+    
+    resetTempo();  // Reset tempo to the song tempo
+    is_paused = 0;  // Reset pause state
+}
+
+void pauseSequence(void)
+{
+    if (is_playing && !is_paused) {
+        seqPlayerPause(1);
+        is_paused = 1;
+    } else if (is_playing && is_paused) {
+        seqPlayerPause(0);
+        is_paused = 0;
+    }
+}
+
+const char* getReverbTypeName(short type)
+{
+    switch (type) {
+        case 0: return "OFF";
+        case 1: return "ROOM";
+        case 2: return "STUDIO_A";
+        case 3: return "STUDIO_B";
+        case 4: return "STUDIO_C";
+        case 5: return "HALL";
+        case 6: return "SPACE";
+        case 7: return "ECHO";
+        case 8: return "DELAY";
+        case 9: return "PIPE";
+        default: return "UNKNOWN";
+    }
+}
+
+void adjustMenuValue(int direction, int amount)
+{
+    // direction: -1 for decrease, 1 for increase
+    // amount: how much to adjust by
+    
+    switch (menu_cursor) {
+        case MENU_TEMPO:
+            current_tempo += (direction * amount);
+            if (current_tempo < TEMPO_MIN) current_tempo = TEMPO_MIN;
+            if (current_tempo > TEMPO_MAX) current_tempo = TEMPO_MAX;
+            tempo_changed = (current_tempo != song_tempo);
+            seqPlayerSetTempoScale(current_tempo, song_tempo);
+            break;
+            
+        case MENU_SEEK:
+            seekBars(direction * amount);
+            break;
+            
+        case MENU_REV_TYPE:
+            reverb_type += direction;
+            if (reverb_type < 0) reverb_type = 0;
+            if (reverb_type > 9) reverb_type = 9;
+            SsUtSetReverbType(reverb_type);
+            // Reapply reverb depth when changing type
+            SsUtSetReverbDepth(reverb_depth_left, reverb_depth_right);
+            break;
+            
+        case MENU_REV_DEPTH:
+            reverb_depth_left += (direction * amount);
+            reverb_depth_right += (direction * amount);
+            if (reverb_depth_left < 0) {
+                reverb_depth_left = 0;
+                reverb_depth_right = 0;
+            }
+            if (reverb_depth_left > 127) {
+                reverb_depth_left = 127;
+                reverb_depth_right = 127;
+            }
+            SsUtSetReverbDepth(reverb_depth_left, reverb_depth_right);
+            break;
+            
+        case MENU_REV_DELAY:
+            reverb_delay += (direction * amount);
+            if (reverb_delay < 0) reverb_delay = 0;
+            if (reverb_delay > 127) reverb_delay = 127;
+            SsUtSetReverbDelay(reverb_delay);
+            break;
+            
+        case MENU_REV_FEEDBACK:
+            reverb_feedback += (direction * amount);
+            if (reverb_feedback < 0) reverb_feedback = 0;
+            if (reverb_feedback > 127) reverb_feedback = 127;
+            SsUtSetReverbFeedback(reverb_feedback);
+            break;
+    }
+}
+
+void toggleMinMax(void)
+{
+    switch (menu_cursor) {
         case MENU_TEMPO:
-            current_tempo = (current_tempo == 240) ? 30 : 240;
-            tempo_changed = 1;  // Mark as changed
-            if (is_playing && current_audio.seq_id >= 0) {
-                if (current_tempo == 240) {
-                    SsSeqSetAccelerando(current_audio.seq_id, current_tempo, 120);
+            current_tempo = (current_tempo == TEMPO_MAX) ? TEMPO_MIN : TEMPO_MAX;
+            tempo_changed = (current_tempo != song_tempo);
+            seqPlayerSetTempoScale(current_tempo, song_tempo);
+            break;
+            
+        case MENU_SEEK:
+            // Jump between the first and the last bar
+            if (is_playing && current_audio.song != NULL) {
+                if (seq_player.tick < seqBarTicks(current_audio.song)) {
+                    seekBars(current_audio.song->end_tick / seqBarTicks(current_audio.song));
                 } else {
-                    SsSeqSetRitardando(current_audio.seq_id, current_tempo, 120);
+                    seqPlayerSeek(0);
                 }
             }
             break;
@@ -613,63 +2967,159 @@ void toggleMinMax(void)
     }
 }
 
-void playNote(void)
+void seekBars(int bars)
 {
-    short program_to_use;
-    short tone_to_use;
+    u_int bar_ticks;
+    int bar;
     
-    // Use edit_program if in editor states, otherwise use current_program
-    if (current_state == STATE_PROGRAM_EDIT || current_state == STATE_TONE_EDIT) {
-        program_to_use = edit_program;
-        // In Tone Editor, use the currently selected tone
-        if (current_state == STATE_TONE_EDIT) {
-            tone_to_use = edit_tone;
-        } else {
-            tone_to_use = 0;
-        }
-    } else {
-        program_to_use = current_program;
-        tone_to_use = 0;
-    }
+    // Seeking only makes sense while the sequence is running
+    if (!is_playing || current_audio.song == NULL) return;
     
-    // Stop any currently playing note
-    if (note_playing && current_voice >= 0) {
-        stopNote();
+    bar_ticks = seqBarTicks(current_audio.song);
+    bar = (int)(seq_player.tick / bar_ticks) + bars;
+    if (bar < 0) bar = 0;
+    if ((u_int)bar * bar_ticks > current_audio.song->end_tick) {
+        bar = current_audio.song->end_tick / bar_ticks;
     }
     
-    // Play the note using the appropriate program, tone, and note value
-    // SsUtKeyOn(vab_id, program, tone, note, fine, vol_left, vol_right)
-    current_voice = SsUtKeyOn(current_audio.vab_id, program_to_use, tone_to_use, current_note, 0, 127, 127);
+    seqPlayerSeek(bar * bar_ticks);
+}
+
+// Key on one held note. Returns its slot, -1 if no slot or voice is free
+int auditionNoteOn(int note, int program, int tone, int latched)
+{
+    int slot, voice;
     
-    if (current_voice >= 0) {
-        note_playing = 1;
+    for (slot = 0; slot < AUDITION_SLOTS; slot++) {
+        if (audition_slots[slot].voice < 0) break;
     }
+    if (slot == AUDITION_SLOTS) return -1;
+    
+    // Auditioned notes take the highest priority so they always get a voice
+    voice = voiceAlloc(15);
+    if (voice < 0) return -1;
+    
+    drvKeyOn(voice, program, tone, note, 127, 127, 64);
+    seq_voices[voice].channel = -1;
+    seq_voices[voice].note = note;
+    seq_voices[voice].program = program;
+    seq_voices[voice].tone = tone;
+    
+    audition_slots[slot].voice = voice;
+    audition_slots[slot].note = note;
+    audition_slots[slot].latched = latched;
+    voice_audition[voice] = slot;
+    audition_count++;
+    if (latched) audition_latched++;
+    return slot;
 }
 
-void stopNote(void)
+void auditionNoteOff(int slot)
+{
+    int voice = audition_slots[slot].voice;
+    
+    if (voice < 0) return;
+    drvKeyOff(voice);
+    voiceRelease(voice);
+    auditionForget(voice);
+}
+
+// Free the slot of a voice that is keyed off or stolen
+void auditionForget(int voice)
+{
+    int slot = voice_audition[voice];
+    
+    if (slot < 0) return;
+    voice_audition[voice] = -1;
+    audition_slots[slot].voice = -1;
+    audition_count--;
+    if (audition_slots[slot].latched) audition_latched--;
+}
+
+// Key on every note of the selected chord in one KON write
+void auditionChord(int latched)
 {
+    const AuditionChord* chord = &audition_chords[audition_chord];
     short program_to_use;
-    short tone_to_use;
+    u_long mask;
+    int played = 0;
+    int i, note;
     
     // Use edit_program if in editor states, otherwise use current_program
     if (current_state == STATE_PROGRAM_EDIT || current_state == STATE_TONE_EDIT) {
         program_to_use = edit_program;
-        // In Tone Editor, use the currently selected tone
+    } else {
+        program_to_use = current_program;
+    }
+    vabAttrFlush();
+    if (drv_vab != current_audio.vab_id) drvBuild();
+    
+    // The sound tick shares the voices and the key-on masks
+#if PROFILE_FRAME
+    u_long start = profNow();
+#endif
+    EnterCriticalSection();
+    for (i = 0; i < chord->count; i++) {
+        note = current_note + chord->intervals[i];
+        if (note < 0 || note > 127) continue;
+        
+        // In Tone Editor, the selected tone. Otherwise the tones the program
+        // plays for the note, or tone 0 outside every range
         if (current_state == STATE_TONE_EDIT) {
-            tone_to_use = edit_tone;
+            mask = 1 << edit_tone;
         } else {
-            tone_to_use = 0;
+            mask = drv_note_tones[program_to_use][note];
+            if (mask == 0) mask = 1;
         }
-    } else {
-        program_to_use = current_program;
-        tone_to_use = 0;
+        for (; mask != 0; mask &= mask - 1) {
+            if (auditionNoteOn(note, program_to_use, lowestBit(mask), latched) >= 0) played++;
+        }
+    }
+    drvCommit();
+    ExitCriticalSection();
+#if PROFILE_FRAME
+    if (played > 0) {
+        keyon_cost = profNow() - start;
+        keyon_latency = profNow() - pad_time;
+        if (keyon_cost > keyon_cost_max) keyon_cost_max = keyon_cost;
+    }
+#endif
+    if (played > 0 && !latched) note_playing = 1;
+}
+
+// Key off every note, held ones included
+void auditionReleaseAll(void)
+{
+    int slot;
+    
+    EnterCriticalSection();
+    for (slot = 0; slot < AUDITION_SLOTS; slot++) {
+        auditionNoteOff(slot);
     }
+    drvCommit();
+    ExitCriticalSection();
+    note_playing = 0;
+}
+
+void playNote(void)
+{
+    // Stop any currently playing chord, held notes keep sounding
+    stopNote();
+    auditionChord(0);
+}
+
+void stopNote(void)
+{
+    int slot;
     
-    if (note_playing && current_voice >= 0) {
-        // SsUtKeyOff(voice_channel, vab_id, program, tone, note)
-        SsUtKeyOff(current_voice, current_audio.vab_id, program_to_use, tone_to_use, current_note);
+    if (note_playing) {
+        EnterCriticalSection();
+        for (slot = 0; slot < AUDITION_SLOTS; slot++) {
+            if (!audition_slots[slot].latched) auditionNoteOff(slot);
+        }
+        drvCommit();
+        ExitCriticalSection();
         note_playing = 0;
-        current_voice = -1;
     }
 }
 
@@ -702,6 +3152,15 @@ void adjustVabMenuValue(int direction, int amount)
             }
             break;
             
+        case VAB_MENU_CHORD:
+            audition_chord += direction;
+            if (audition_chord < 0) audition_chord = 0;
+            if (audition_chord >= (int)AUDITION_CHORDS) audition_chord = AUDITION_CHORDS - 1;
+            if (was_playing) {
+                playNote();
+            }
+            break;
+            
         case VAB_MENU_REV_TYPE:
             reverb_type += direction;
             if (reverb_type < 0) reverb_type = 0;
@@ -752,6 +3211,10 @@ void toggleVabMinMax(void)
             current_program = (current_program == current_audio.num_programs - 1) ? 0 : current_audio.num_programs - 1;
             break;
             
+        case VAB_MENU_CHORD:
+            audition_chord = (audition_chord == (int)AUDITION_CHORDS - 1) ? 0 : AUDITION_CHORDS - 1;
+            break;
+            
         case VAB_MENU_REV_TYPE:
             reverb_type = (reverb_type == 9) ? 0 : 9;
             SsUtSetReverbType(reverb_type);
@@ -787,11 +3250,7 @@ void enterProgramEdit(void)
     
     // Ensure VAB is loaded (if not already loaded, load it now)
     if (current_audio.vab_id < 0 && current_audio.vh_data != NULL) {
-        current_audio.vab_id = SsVabOpenHead(current_audio.vh_data, -1);
-        if (current_audio.vab_id >= 0) {
-            SsVabTransBody(current_audio.vb_data, current_audio.vab_id);
-            SsVabTransCompleted(SS_WAIT_COMPLETED);
-        }
+        current_audio.vab_id = vabCacheOpen(selected_vh);
     }
     
     // Load VAB header to get master vol/pan
@@ -801,67 +3260,458 @@ void enterProgramEdit(void)
     original_master_vol = vab_master_vol;
     original_master_pan = vab_master_pan;
     
+    edit_status[0] = 0;
+    
     // Start with program 0
     edit_program = current_program;
     edit_tone = 0;
     
-    // Load program data
-    loadProgramData();
+    // Load program data
+    loadProgramData();
+    
+    current_state = STATE_PROGRAM_EDIT;
+    menu_cursor = 0;
+}
+
+// Fill the attribute cache from the current soundbank's VH
+void vabAttrBuild(void)
+{
+    ProgAtr* progs = (ProgAtr*)(current_audio.vh_data + sizeof(VabHdr));
+    VagAtr* tones = (VagAtr*)(current_audio.vh_data + sizeof(VabHdr) + 128 * sizeof(ProgAtr));
+    VagAtr* atr;
+    int prog, t, i;
+    
+    indexVabPrograms();
+    for (prog = 0; prog < 128; prog++) {
+        attr_prog_mvol[prog] = progs[prog].mvol;
+        attr_prog_mpan[prog] = progs[prog].mpan;
+        attr_prog_edited[prog] = 0;
+        if (vab_prog_block[prog] < 0) continue;
+        
+        attr_block_prog[vab_prog_block[prog]] = prog;
+        for (t = 0; t < 16; t++) {
+            i = vab_prog_block[prog] * 16 + t;
+            atr = &tones[i];
+            attr_tone_prior[i] = atr->prior;
+            attr_tone_mode[i] = atr->mode;
+            attr_tone_vol[i] = atr->vol;
+            attr_tone_pan[i] = atr->pan;
+            attr_tone_center[i] = atr->center;
+            attr_tone_shift[i] = atr->shift;
+            attr_tone_min[i] = atr->min;
+            attr_tone_max[i] = atr->max;
+            attr_tone_pbmin[i] = atr->pbmin;
+            attr_tone_pbmax[i] = atr->pbmax;
+            attr_tone_adsr1[i] = atr->adsr1;
+            attr_tone_adsr2[i] = atr->adsr2;
+            attr_tone_edited[i] = 0;
+        }
+    }
+    memset(attr_prog_dirty, 0, sizeof(attr_prog_dirty));
+    memset(attr_tone_dirty, 0, sizeof(attr_tone_dirty));
+    attr_dirty = 0;
+    attr_drv_all = 0;
+    attr_vab = current_audio.vab_id;
+}
+
+// Hand the programs and tones changed in the cache to libsnd, which writes
+// them into the VH, and log the changed bytes for the memory card. Called
+// once a frame, so holding a button only costs a cache write per repeat
+void vabAttrFlush(void)
+{
+    ProgAtr* progs = (ProgAtr*)(current_audio.vh_data + sizeof(VabHdr));
+    VagAtr* tones = (VagAtr*)(current_audio.vh_data + sizeof(VabHdr) + 128 * sizeof(ProgAtr));
+    u_long rebuild[128 / 32];
+    ProgAtr prog_atr;
+    VagAtr vag_atr;
+    u_long mask;
+    int prog, t, i, w;
+    
+    if (!attr_dirty) return;
+    attr_dirty = 0;
+    if (attr_vab < 0 || attr_vab != current_audio.vab_id) return;
+    
+    for (w = 0; w < 128 / 32; w++) {
+        rebuild[w] = attr_prog_dirty[w];
+        for (mask = attr_prog_dirty[w]; mask != 0; mask &= mask - 1) {
+            prog = w * 32 + lowestBit(mask);
+            prog_atr = progs[prog];
+            prog_atr.mvol = attr_prog_mvol[prog];
+            prog_atr.mpan = attr_prog_mpan[prog];
+            editDiff(prog, EDIT_PROGRAM, (u_char*)&progs[prog], (u_char*)&prog_atr, sizeof(ProgAtr));
+            SsUtSetProgAtr(attr_vab, prog, &prog_atr);
+        }
+        attr_prog_dirty[w] = 0;
+    }
+    
+    for (w = 0; w < DRV_MAX_TONES / 32; w++) {
+        for (mask = attr_tone_dirty[w]; mask != 0; mask &= mask - 1) {
+            i = w * 32 + lowestBit(mask);
+            prog = attr_block_prog[i / 16];
+            t = i % 16;
+            vag_atr = tones[i];
+            vag_atr.prior = attr_tone_prior[i];
+            vag_atr.mode = attr_tone_mode[i];
+            vag_atr.vol = attr_tone_vol[i];
+            vag_atr.pan = attr_tone_pan[i];
+            vag_atr.center = attr_tone_center[i];
+            vag_atr.shift = attr_tone_shift[i];
+            vag_atr.min = attr_tone_min[i];
+            vag_atr.max = attr_tone_max[i];
+            vag_atr.pbmin = attr_tone_pbmin[i];
+            vag_atr.pbmax = attr_tone_pbmax[i];
+            vag_atr.adsr1 = attr_tone_adsr1[i];
+            vag_atr.adsr2 = attr_tone_adsr2[i];
+            editDiff(prog, t, (u_char*)&tones[i], (u_char*)&vag_atr, sizeof(VagAtr));
+            SsUtSetVagAtr(attr_vab, prog, t, &vag_atr);
+            rebuild[prog / 32] |= 1 << (prog % 32);
+        }
+        attr_tone_dirty[w] = 0;
+    }
     
-    current_state = STATE_PROGRAM_EDIT;
-    menu_cursor = 0;
+    // Driver table entries of the changed programs. The sound tick reads them,
+    // so each program is rewritten with its interrupt held off
+    if (attr_drv_all) {
+        for (w = 0; w < 128 / 32; w++) rebuild[w] = 0xFFFFFFFF;
+        attr_drv_all = 0;
+    }
+    if (drv_vab < 0 || drv_vab != attr_vab) return;
+    for (w = 0; w < 128 / 32; w++) {
+        for (mask = rebuild[w]; mask != 0; mask &= mask - 1) {
+            EnterCriticalSection();
+            drvBuildProgram(w * 32 + lowestBit(mask));
+            ExitCriticalSection();
+        }
+    }
 }
 
 void loadProgramData(void)
 {
-    // Load program attributes
-    if (SsUtGetProgAtr(current_audio.vab_id, edit_program, &current_prog_atr) == 0) {
-        // Save original for change detection
-        original_prog_atr = current_prog_atr;
-    }
+    // Program attributes from the cache, the fields it does not keep from the VH
+    if (attr_vab < 0 || attr_vab != current_audio.vab_id) vabAttrBuild();
+    current_prog_atr = ((ProgAtr*)(current_audio.vh_data + sizeof(VabHdr)))[edit_program];
+    current_prog_atr.mvol = attr_prog_mvol[edit_program];
+    current_prog_atr.mpan = attr_prog_mpan[edit_program];
 }
 
 void loadToneData(void)
 {
-    // Load tone attributes
-    if (SsUtGetVagAtr(current_audio.vab_id, edit_program, edit_tone, &current_vag_atr) == 0) {
-        // Save original for change detection
-        original_vag_atr = current_vag_atr;
-        
-        // Check if min and max are the same (single note mapping)
-        if (current_vag_atr.min == current_vag_atr.max && vab_mode) {
-            // Set current note to the min/max value
-            current_note = current_vag_atr.min;
-        }
+    int block = vab_prog_block[edit_program];
+    int i = block * 16 + edit_tone;
+    
+    // Tone attributes from the cache, the fields it does not keep from the VH
+    if (attr_vab < 0 || attr_vab != current_audio.vab_id) vabAttrBuild();
+    if (block < 0) return;
+    current_vag_atr = ((VagAtr*)(current_audio.vh_data + sizeof(VabHdr) + 128 * sizeof(ProgAtr)))[i];
+    current_vag_atr.prior = attr_tone_prior[i];
+    current_vag_atr.mode = attr_tone_mode[i];
+    current_vag_atr.vol = attr_tone_vol[i];
+    current_vag_atr.pan = attr_tone_pan[i];
+    current_vag_atr.center = attr_tone_center[i];
+    current_vag_atr.shift = attr_tone_shift[i];
+    current_vag_atr.min = attr_tone_min[i];
+    current_vag_atr.max = attr_tone_max[i];
+    current_vag_atr.pbmin = attr_tone_pbmin[i];
+    current_vag_atr.pbmax = attr_tone_pbmax[i];
+    current_vag_atr.adsr1 = attr_tone_adsr1[i];
+    current_vag_atr.adsr2 = attr_tone_adsr2[i];
+    
+    // Check if min and max are the same (single note mapping)
+    if (current_vag_atr.min == current_vag_atr.max && vab_mode) {
+        // Set current note to the min/max value
+        current_note = current_vag_atr.min;
     }
 }
 
+// Tone Editor: follow the note to the tone it plays, unless the selected
+// tone plays it too (drum kits map one tone per note)
+void selectNoteTone(void)
+{
+    u_short mask = drvNoteTones(edit_program, current_note);
+    
+    if (mask == 0 || (mask & (1 << edit_tone))) return;
+    edit_tone = lowestBit(mask);
+    loadToneData();
+}
+
+// Store a field in the attribute cache: mark it edited and its program or
+// tone dirty if the value changes
+#define ATTR_STORE(field, index, value, item, edited, dirty) do { \
+    if (field[index] != (value)) { \
+        field[index] = (value); \
+        edited[index] |= 1 << (item); \
+        dirty[(index) / 32] |= 1 << ((index) % 32); \
+        attr_dirty = 1; \
+    } \
+} while (0)
+
 void saveProgramData(void)
 {
-    // Save program attributes
-    SsUtSetProgAtr(current_audio.vab_id, edit_program, &current_prog_atr);
+    VabHdr vab_hdr_new;
+    int p = edit_program;
+    
+    // Program attributes go to libsnd at the next vabAttrFlush
+    if (attr_vab < 0 || attr_vab != current_audio.vab_id) vabAttrBuild();
+    ATTR_STORE(attr_prog_mvol, p, current_prog_atr.mvol, PROG_MENU_PROG_VOL, attr_prog_edited, attr_prog_dirty);
+    ATTR_STORE(attr_prog_mpan, p, current_prog_atr.mpan, PROG_MENU_PROG_PAN, attr_prog_edited, attr_prog_dirty);
     
     // Update VAB header master vol/pan if changed
     if (vab_master_vol != original_master_vol || vab_master_pan != original_master_pan) {
         VabHdr* vab_hdr = (VabHdr*)current_audio.vh_data;
+        vab_hdr_new = *vab_hdr;
+        vab_hdr_new.mvol = vab_master_vol;
+        vab_hdr_new.pan = vab_master_pan;
+        editDiff(EDIT_HEADER, 0, (u_char*)vab_hdr, (u_char*)&vab_hdr_new, sizeof(VabHdr));
         vab_hdr->mvol = vab_master_vol;
         vab_hdr->pan = vab_master_pan;  // VabHdr has 'pan', not 'mpan'
+        attr_drv_all = 1;  // Every tone's volume, rebuilt at the next vabAttrFlush
+        attr_dirty = 1;
     }
 }
 
 void saveToneData(void)
 {
-    // Save tone attributes
-    SsUtSetVagAtr(current_audio.vab_id, edit_program, edit_tone, &current_vag_atr);
+    VagAtr* atr = &current_vag_atr;
+    int block = vab_prog_block[edit_program];
+    int i = block * 16 + edit_tone;
+    
+    // Tone attributes go to libsnd at the next vabAttrFlush
+    if (attr_vab < 0 || attr_vab != current_audio.vab_id) vabAttrBuild();
+    if (block < 0) return;
+    ATTR_STORE(attr_tone_prior, i, atr->prior, TONE_MENU_PRIOR, attr_tone_edited, attr_tone_dirty);
+    ATTR_STORE(attr_tone_mode, i, atr->mode, TONE_MENU_MODE, attr_tone_edited, attr_tone_dirty);
+    ATTR_STORE(attr_tone_vol, i, atr->vol, TONE_MENU_VOL, attr_tone_edited, attr_tone_dirty);
+    ATTR_STORE(attr_tone_pan, i, atr->pan, TONE_MENU_PAN, attr_tone_edited, attr_tone_dirty);
+    ATTR_STORE(attr_tone_center, i, atr->center, TONE_MENU_CENTER, attr_tone_edited, attr_tone_dirty);
+    ATTR_STORE(attr_tone_shift, i, atr->shift, TONE_MENU_SHIFT, attr_tone_edited, attr_tone_dirty);
+    ATTR_STORE(attr_tone_min, i, atr->min, TONE_MENU_MIN, attr_tone_edited, attr_tone_dirty);
+    ATTR_STORE(attr_tone_max, i, atr->max, TONE_MENU_MAX, attr_tone_edited, attr_tone_dirty);
+    ATTR_STORE(attr_tone_pbmin, i, atr->pbmin, TONE_MENU_PBMIN, attr_tone_edited, attr_tone_dirty);
+    ATTR_STORE(attr_tone_pbmax, i, atr->pbmax, TONE_MENU_PBMAX, attr_tone_edited, attr_tone_dirty);
+    ATTR_STORE(attr_tone_adsr1, i, atr->adsr1, TONE_MENU_ADSR1, attr_tone_edited, attr_tone_dirty);
+    ATTR_STORE(attr_tone_adsr2, i, atr->adsr2, TONE_MENU_ADSR2, attr_tone_edited, attr_tone_dirty);
+}
+
+// Memory card: soundbank edits
+
+void cardInit(void)
+{
+    InitCARD(1);  // Shares the port with the pads
+    StartCARD();
+    _bu_init();
+    ChangeClearPad(0);
+}
+
+// File of a soundbank's edits on the card in slot 1
+void cardName(char* name, u_int hash)
+{
+    sprintf(name, "bu00:BASEQPLAY%08X", hash);
+}
+
+// Log one changed byte of the soundbank with this hash (replacing its earlier
+// value). -1 if the log is full
+int editRecord(u_int hash, int program, int tone, int offset, int value)
+{
+    EditRecord* record;
+    int i;
+    
+    for (i = 0; i < edit_count; i++) {
+        record = &edit_log[i];
+        if (edit_log_hash[i] == hash && record->program == program && record->tone == tone &&
+            record->offset == offset) {
+            record->value = value;
+            return 0;
+        }
+    }
+    if (edit_count == EDIT_LOG_SIZE) return -1;
+    
+    record = &edit_log[edit_count];
+    record->program = program;
+    record->tone = tone;
+    record->offset = offset;
+    record->value = value;
+    edit_log_hash[edit_count++] = hash;
+    return 0;
+}
+
+// Log the bytes of an attribute structure of the soundbank being edited that
+// differ between old and now
+void editDiff(int program, int tone, u_char* old, u_char* now, int size)
+{
+    u_int hash = vh_files[selected_vh].hash;
+    int i;
+    
+    for (i = 0; i < size; i++) {
+        if (old[i] == now[i]) continue;
+        if (editRecord(hash, program, tone, i, now[i]) < 0) {
+            sprintf(edit_status, "Too many changes, not logged");
+        }
+    }
+}
+
+// Read the card file of a soundbank into the log, once per session. The file
+// was written from the log, so its records go in as they are
+void editLoad(u_int hash)
+{
+    u_char* buf = (u_char*)card_buffer;
+    EditHeader* header = (EditHeader*)buf;
+    EditRecord* records = (EditRecord*)(header + 1);
+    char name[32];
+    long fd;
+    long size;
+    int i;
+    
+    for (i = 0; i < edit_num_banks; i++) {
+        if (edit_banks[i] == hash) return;
+    }
+    if (edit_num_banks == EDIT_BANKS) return;
+    edit_banks[edit_num_banks++] = hash;
+    
+    cardName(name, hash);
+    fd = open(name, O_RDONLY);
+    if (fd < 0) return;
+    
+    // The header and the first records are in the first data frame
+    if (lseek(fd, CARD_DATA, SEEK_SET) < 0 || read(fd, buf, CARD_FRAME) != CARD_FRAME ||
+        header->magic != EDIT_MAGIC || header->hash != hash || header->count > EDIT_LOG_SIZE) {
+        close(fd);
+        return;
+    }
+    size = (sizeof(EditHeader) + header->count * sizeof(EditRecord) + CARD_FRAME - 1) & ~(CARD_FRAME - 1);
+    if (size > CARD_FRAME && read(fd, buf + CARD_FRAME, size - CARD_FRAME) != size - CARD_FRAME) {
+        close(fd);
+        return;
+    }
+    close(fd);
+    
+    if (pakHash((u_char*)records, header->count * sizeof(EditRecord), PAK_HASH_INIT) != header->check) return;
+    for (i = 0; i < header->count; i++) {
+        editRecord(hash, records[i].program, records[i].tone, records[i].offset, records[i].value);
+    }
+}
+
+// Write the logged edits of vh_files[vh] into its VH, in one pass over the log.
+// Called before libsnd opens the VH (it reads the attributes in place), so
+// card edits are there from the first note
+void editApply(int vh)
+{
+    u_char* data = vh_files[vh].data;
+    u_int hash = vh_files[vh].hash;
+    short blocks[128];
+    EditRecord* record;
+    int i;
+    
+    editLoad(hash);
+    vhToneBlocks(data, blocks);
+    
+    for (i = 0; i < edit_count; i++) {
+        record = &edit_log[i];
+        if (edit_log_hash[i] != hash) continue;
+        if (record->program == EDIT_HEADER) {
+            if (record->offset < sizeof(VabHdr)) data[record->offset] = record->value;
+        } else if (record->program < 128 && record->tone == EDIT_PROGRAM) {
+            if (record->offset < sizeof(ProgAtr)) {
+                data[sizeof(VabHdr) + record->program * sizeof(ProgAtr) + record->offset] = record->value;
+            }
+        } else if (record->program < 128 && blocks[record->program] >= 0 && record->tone < 16 &&
+                   record->offset < sizeof(VagAtr)) {
+            data[sizeof(VabHdr) + 128 * sizeof(ProgAtr) +
+                 (blocks[record->program] * 16 + record->tone) * sizeof(VagAtr) + record->offset] = record->value;
+        }
+    }
+}
+
+// Save the logged edits of vh_files[vh] to its card file (one block). Only the
+// title, icon and the frames holding records are written
+void editSave(int vh)
+{
+    // 16x16 icon, 4 bits per pixel
+    static const char* icon[16] = {
+        "................",
+        ".......##.......",
+        ".......###......",
+        ".......####.....",
+        ".......##.##....",
+        ".......##..##...",
+        ".......##...#...",
+        ".......##.......",
+        ".......##.......",
+        ".......##.......",
+        "...######.......",
+        "..#######.......",
+        "..#######.......",
+        "...#####........",
+        "................",
+        "................"
+    };
+    u_char* buf = (u_char*)card_buffer;
+    EditHeader* header = (EditHeader*)(buf + CARD_DATA);
+    EditRecord* records = (EditRecord*)(header + 1);
+    u_short* clut = (u_short*)(buf + 0x60);
+    u_int hash = vh_files[vh].hash;
+    char name[32];
+    long fd;
+    long size;
+    int count = 0;
+    int i, x;
+    
+    vabAttrFlush();  // Edits of this frame are not logged yet
+    for (i = 0; i < edit_count; i++) {
+        if (edit_log_hash[i] == hash) records[count++] = edit_log[i];
+    }
+    if (count == 0) {
+        sprintf(edit_status, "No changes to save");
+        return;
+    }
+    size = CARD_DATA + ((sizeof(EditHeader) + count * sizeof(EditRecord) + CARD_FRAME - 1) & ~(CARD_FRAME - 1));
+    memset(records + count, 0, buf + size - (u_char*)(records + count));
+    header->magic = EDIT_MAGIC;
+    header->hash = hash;
+    header->count = count;
+    header->reserved = 0;
+    header->check = pakHash((u_char*)records, count * sizeof(EditRecord), PAK_HASH_INIT);
+    
+    // Title frame: "SC", one icon frame, one block, title, palette
+    memset(buf, 0, CARD_DATA);
+    buf[0] = 'S';
+    buf[1] = 'C';
+    buf[2] = 0x11;
+    buf[3] = 1;
+    sprintf((char*)buf + 4, "SEQ PLAYER %.31s", vh_files[vh].name);
+    clut[0] = 0x2800;  // Dark blue
+    clut[1] = 0x7FFF;  // White
+    for (i = 0; i < 16; i++) {
+        for (x = 0; x < 16; x++) {
+            if (icon[i][x] == '#') buf[CARD_FRAME + i * 8 + x / 2] |= (x & 1) ? 0x10 : 0x01;
+        }
+    }
+    
+    // Card I/O waits for the card, a few frames at most for one record frame
+    cardName(name, hash);
+    fd = open(name, O_WRONLY);
+    if (fd < 0) {
+        fd = open(name, O_CREAT | (1 << 16));  // One block
+        if (fd >= 0) close(fd);
+        fd = open(name, O_WRONLY);
+    }
+    if (fd < 0) {
+        sprintf(edit_status, "No formatted memory card in slot 1");
+        return;
+    }
+    if (write(fd, buf, size) == size) {
+        sprintf(edit_status, "Saved %d changes (%ld bytes)", count, size);
+    } else {
+        sprintf(edit_status, "Memory card write failed");
+    }
+    close(fd);
 }
 
 int isProgramValueChanged(int menu_item)
 {
     switch (menu_item) {
         case PROG_MENU_PROG_VOL:
-            return current_prog_atr.mvol != original_prog_atr.mvol;
         case PROG_MENU_PROG_PAN:
-            return current_prog_atr.mpan != original_prog_atr.mpan;
+            return attr_vab >= 0 && (attr_prog_edited[edit_program] & (1 << menu_item)) != 0;
         case PROG_MENU_MASTER_VOL:
             return vab_master_vol != original_master_vol;
         case PROG_MENU_MASTER_PAN:
@@ -871,36 +3721,13 @@ int isProgramValueChanged(int menu_item)
     }
 }
 
+// Edited since the attribute cache was built (a bit per field)
 int isToneValueChanged(int menu_item)
 {
-    switch (menu_item) {
-        case TONE_MENU_PRIOR:
-            return current_vag_atr.prior != original_vag_atr.prior;
-        case TONE_MENU_MODE:
-            return current_vag_atr.mode != original_vag_atr.mode;
-        case TONE_MENU_VOL:
-            return current_vag_atr.vol != original_vag_atr.vol;
-        case TONE_MENU_PAN:
-            return current_vag_atr.pan != original_vag_atr.pan;
-        case TONE_MENU_CENTER:
-            return current_vag_atr.center != original_vag_atr.center;
-        case TONE_MENU_SHIFT:
-            return current_vag_atr.shift != original_vag_atr.shift;
-        case TONE_MENU_MIN:
-            return current_vag_atr.min != original_vag_atr.min;
-        case TONE_MENU_MAX:
-            return current_vag_atr.max != original_vag_atr.max;
-        case TONE_MENU_PBMIN:
-            return current_vag_atr.pbmin != original_vag_atr.pbmin;
-        case TONE_MENU_PBMAX:
-            return current_vag_atr.pbmax != original_vag_atr.pbmax;
-        case TONE_MENU_ADSR1:
-            return current_vag_atr.adsr1 != original_vag_atr.adsr1;
-        case TONE_MENU_ADSR2:
-            return current_vag_atr.adsr2 != original_vag_atr.adsr2;
-        default:
-            return 0;
-    }
+    int block = vab_prog_block[edit_program];
+    
+    if (attr_vab < 0 || block < 0) return 0;
+    return (attr_tone_edited[block * 16 + edit_tone] & (1 << menu_item)) != 0;
 }
 
 void adjustProgramEditValue(int direction, int amount)
@@ -1010,6 +3837,7 @@ void adjustToneEditValue(int direction, int amount)
                 current_note += (direction * amount);
                 if (current_note < 0) current_note = 0;
                 if (current_note > 127) current_note = 127;
+                selectNoteTone();
                 // Retrigger note if playing
                 if (was_playing) playNote();
             }
@@ -1122,6 +3950,7 @@ void toggleToneEditMinMax(void)
         case TONE_MENU_NOTE_SEL:
             if (vab_mode) {
                 current_note = (current_note == 127) ? 0 : 127;
+                selectNoteTone();
             }
             break;
             
@@ -1428,11 +4257,26 @@ int isAdsrValueChanged(int menu_item)
 void processInput(void)
 {
     pad = PadRead(0);
+#if PROFILE_FRAME
+    pad_time = profNow();
+#endif
     
     // Global controls that work in all states
     
+    // Set when Select+Start was handled, so neither button also acts alone this frame
+    int combo_pressed = 0;
+    
+#if PROFILE_FRAME
+    // Select+Start - Toggle the frame profiler overlay
+    if ((pad & PADselect) && (pad & PADstart) && !(oldpad & PADstart)) {
+        prof_visible = !prof_visible;
+        profReset();
+        combo_pressed = 1;
+    }
+#endif
+    
     // Select button behavior in playback states
-    if (pad & PADselect && !(oldpad & PADselect)) {
+    if (!combo_pressed && pad & PADselect && !(oldpad & PADselect)) {
         if (current_state == STATE_PLAYBACK || current_state == STATE_VAB_PLAYBACK) {
 			#if HAS_BACKGROUND_IMAGE
 						// If background image present, Select toggles background
@@ -1446,7 +4290,7 @@ void processInput(void)
     
     // Check if Select is being held (layer modifier active)
     // When Select is held, normal inputs are blocked - only Select+button combos work
-    int select_layer_active = (pad & PADselect) && (oldpad & PADselect);
+    int select_layer_active = ((pad & PADselect) && (oldpad & PADselect)) || combo_pressed;
     
     // Triangle - Play/Stop in SEQ mode (wrapped), Play note in VAB mode (always works)
     if (vab_mode) {
@@ -1457,7 +4301,8 @@ void processInput(void)
         // SEQ mode - Triangle toggles play/stop (disabled when Select held)
         if (!select_layer_active) {
             if (pad & PADRup && !(oldpad & PADRup)) {
-                if (current_state == STATE_PLAYBACK || current_state == STATE_PROGRAM_EDIT || current_state == STATE_TONE_EDIT) {
+                if (current_state == STATE_PLAYBACK || current_state == STATE_VOICE_MONITOR ||
+                    current_state == STATE_PROGRAM_EDIT || current_state == STATE_TONE_EDIT) {
                     if (is_playing) {
                         stopSequence();
                     } else {
@@ -1469,7 +4314,8 @@ void processInput(void)
     }
     
     // Start button - Pause in SEQ mode (disabled if Select held)
-    if (!select_layer_active && !vab_mode && (current_state == STATE_PLAYBACK || current_state == STATE_PROGRAM_EDIT || current_state == STATE_TONE_EDIT)) {
+    if (!select_layer_active && !vab_mode && (current_state == STATE_PLAYBACK || current_state == STATE_VOICE_MONITOR ||
+                                              current_state == STATE_PROGRAM_EDIT || current_state == STATE_TONE_EDIT)) {
         if (pad & PADstart && !(oldpad & PADstart)) {
             pauseSequence();
         }
@@ -1493,22 +4339,25 @@ void processInput(void)
         case STATE_SEQ_SELECT:
             if (pad & PADLup && !(oldpad & PADLup)) {
                 cursor--;
-                if (cursor < 0) cursor = MAX_SEQ_FILES - 1;
+                if (cursor < 0) cursor = num_seq_files - 1;
             }
             if (pad & PADLdown && !(oldpad & PADLdown)) {
                 cursor++;
-                if (cursor >= MAX_SEQ_FILES) cursor = 0;
+                if (cursor >= num_seq_files) cursor = 0;
             }
-            if (pad & PADRdown && !(oldpad & PADRdown)) { // X button - SEQ mode
+            if (pad & PADRdown && !(oldpad & PADRdown) && num_seq_files > 0 && num_vh_files > 0) { // X button - SEQ mode
                 selected_seq = cursor;
                 vab_mode = 0;
                 current_state = STATE_VH_SELECT;
                 cursor = 0;
             }
-            if (pad & PADRleft && !(oldpad & PADRleft)) { // Square button - VAB mode
+            if (pad & PADRleft && !(oldpad & PADRleft) && num_vh_files > 0) { // Square button - VAB mode
                 vab_mode = 1;
                 current_state = STATE_VAB_VH_SELECT;
                 cursor = 0;
+            }
+            if (pad & PADRup && !(oldpad & PADRup)) { // Triangle button - receive files over serial
+                enterHotLoad();
             }
 			#if HAS_BACKGROUND_IMAGE
 						if (pad & PADselect && !(oldpad & PADselect)) { // Select - Toggle background
@@ -1520,24 +4369,23 @@ void processInput(void)
         case STATE_VH_SELECT:
             if (pad & PADLup && !(oldpad & PADLup)) {
                 cursor--;
-                if (cursor < 0) cursor = MAX_VH_FILES - 1;
+                if (cursor < 0) cursor = num_vh_files - 1;
             }
             if (pad & PADLdown && !(oldpad & PADLdown)) {
                 cursor++;
-                if (cursor >= MAX_VH_FILES) cursor = 0;
+                if (cursor >= num_vh_files) cursor = 0;
             }
             if (pad & PADRdown && !(oldpad & PADRdown)) { // X button
                 selected_vh = cursor;
                 
-                // Close previously loaded VAB if any (changing to new file)
-                if (current_audio.vab_id >= 0) {
-                    SsVabClose(current_audio.vab_id);
-                    current_audio.vab_id = -1;
-                }
+                // Previous soundbank stays resident, this one is opened on play
+                current_audio.vab_id = -1;
                 
                 // Set up audio file structure
                 current_audio.seq_data = seq_files[selected_seq].data;
                 current_audio.seq_size = seq_files[selected_seq].size;
+                current_audio.song = seqLoad(selected_seq);
+                resetTempo();
                 sprintf(current_audio.seq_name, "%s", seq_files[selected_seq].name);
                 
                 current_audio.vh_data = vh_files[selected_vh].data;
@@ -1550,14 +4398,12 @@ void processInput(void)
                 current_audio.num_programs = vab_hdr->ps;  // Note: 'ps' not 'programs'
                 current_audio.num_tones = vab_hdr->ts;     // Note: 'ts' not 'tones'
                 
-                current_state = STATE_PLAYBACK;
+                // Upload the VB now so Start plays without a wait
+                beginBankLoad(STATE_PLAYBACK, STATE_VH_SELECT);
             }
             if (pad & PADRright && !(oldpad & PADRright)) { // Circle button
-                // Going back to SEQ select - close VAB as user may select different SEQ
-                if (current_audio.vab_id >= 0) {
-                    SsVabClose(current_audio.vab_id);
-                    current_audio.vab_id = -1;
-                }
+                // Going back to SEQ select - soundbank stays cached for the next selection
+                current_audio.vab_id = -1;
                 current_state = STATE_SEQ_SELECT;
                 cursor = selected_seq;
             }
@@ -1574,6 +4420,11 @@ void processInput(void)
                     menu_cursor = 0;
                 }
                 
+                // R2 - Voice monitor
+                if (pad & PADR2 && !(oldpad & PADR2)) {
+                    current_state = STATE_VOICE_MONITOR;
+                }
+                
                 
                 // D-Pad Up/Down - Navigate menu with hold detection
             if (pad & PADLup) {
@@ -1625,14 +4476,8 @@ void processInput(void)
                         stopSequence();
                         break;
                     case MENU_TEMPO:
-                        // If tempo is unchanged, set to default 120
-                        if (!tempo_changed) {
-                            current_tempo = 120;
-                            tempo_changed = 1;
-                            if (is_playing && current_audio.seq_id >= 0) {
-                                SsSeqSetAccelerando(current_audio.seq_id, current_tempo, 120);
-                            }
-                        }
+                        // Back to the song tempo
+                        resetTempo();
                         break;
                     case MENU_PROGRAM_EDIT:
                         enterProgramEdit();
@@ -1714,24 +4559,55 @@ void processInput(void)
             
             break;
             
+        case STATE_VOICE_MONITOR:
+            // Circle or R2 - Back to playback
+            if ((pad & PADRright && !(oldpad & PADRright)) || (pad & PADR2 && !(oldpad & PADR2))) {
+                current_state = STATE_PLAYBACK;
+            }
+            // Square - Reset peaks and counters
+            if (pad & PADRleft && !(oldpad & PADRleft)) {
+                voiceResetStats();
+            }
+            break;
+            
+        case STATE_VAB_LOADING:
+            // Circle - Cancel, the bank's SPU RAM is released
+            if (pad & PADRright && !(oldpad & PADRright)) {
+                vabCacheCancel();
+                current_state = load_return_state;
+                break;
+            }
+            current_audio.vab_id = vabCacheStep();
+            if (current_audio.vab_id >= 0) {
+                finishBankLoad();
+            } else if (current_audio.vab_id != VAB_LOADING) {
+                current_state = load_return_state;
+            } else {
+                current_audio.vab_id = -1;
+            }
+            break;
+            
+        case STATE_HOT_LOAD:
+            // Circle - Back, received files stay listed
+            if (pad & PADRright && !(oldpad & PADRright)) {
+                exitHotLoad();
+                break;
+            }
+            hotReceive();
+            break;
+            
         case STATE_VAB_VH_SELECT:
             if (pad & PADLup && !(oldpad & PADLup)) {
                 cursor--;
-                if (cursor < 0) cursor = MAX_VH_FILES - 1;
+                if (cursor < 0) cursor = num_vh_files - 1;
             }
             if (pad & PADLdown && !(oldpad & PADLdown)) {
                 cursor++;
-                if (cursor >= MAX_VH_FILES) cursor = 0;
+                if (cursor >= num_vh_files) cursor = 0;
             }
             if (pad & PADRdown && !(oldpad & PADRdown)) { // X button
                 selected_vh = cursor;
                 
-                // Close previously loaded VAB if any (changing to new file)
-                if (current_audio.vab_id >= 0) {
-                    SsVabClose(current_audio.vab_id);
-                    current_audio.vab_id = -1;
-                }
-                
                 // Set up audio file structure for VAB mode
                 current_audio.vh_data = vh_files[selected_vh].data;
                 current_audio.vb_data = vb_files[selected_vh];
@@ -1743,42 +4619,12 @@ void processInput(void)
                 current_audio.num_programs = vab_hdr->ps;
                 current_audio.num_tones = vab_hdr->ts;
                 
-                // Open VAB for VAB mode
-                current_audio.vab_id = SsVabOpenHead(current_audio.vh_data, -1);
-                if (current_audio.vab_id < 0) {
-                    FntPrint("Failed to open VAB header!\n");
-                    break;
-                }
-                
-                // Transfer VAB body
-                if (SsVabTransBody(current_audio.vb_data, current_audio.vab_id) != current_audio.vab_id) {
-                    FntPrint("Failed to transfer VAB body!\n");
-                    SsVabClose(current_audio.vab_id);
-                    current_audio.vab_id = -1;
-                    break;
-                }
-                SsVabTransCompleted(SS_WAIT_COMPLETED);
-                
-                // Enable reverb
-                SsUtSetReverbType(reverb_type);
-                SsUtReverbOn();
-                SsUtSetReverbDepth(reverb_depth_left, reverb_depth_right);
-                
-                // Reset VAB mode parameters
-                current_note = 60;  // Middle C
-                current_program = 0;
-                note_playing = 0;
-                current_voice = -1;
-                menu_cursor = 0;
-                
-                current_state = STATE_VAB_PLAYBACK;
+                // Open VAB for VAB mode (instant if it is still resident)
+                beginBankLoad(STATE_VAB_PLAYBACK, STATE_VAB_VH_SELECT);
             }
             if (pad & PADRright && !(oldpad & PADRright)) { // Circle button - Back to SEQ select
-                // Close VAB if any (going back to SEQ select)
-                if (current_audio.vab_id >= 0) {
-                    SsVabClose(current_audio.vab_id);
-                    current_audio.vab_id = -1;
-                }
+                // Soundbank stays cached (going back to SEQ select)
+                current_audio.vab_id = -1;
                 current_state = STATE_SEQ_SELECT;
                 cursor = 0;
                 vab_mode = 0;
@@ -1805,11 +4651,8 @@ void processInput(void)
             if (!select_layer_active) {
                 // Circle - Back to VH select
                 if (pad & PADRright && !(oldpad & PADRright)) {
-                    stopNote();
-                    if (current_audio.vab_id >= 0) {
-                        SsVabClose(current_audio.vab_id);
-                        current_audio.vab_id = -1;
-                    }
+                    auditionReleaseAll();
+                    current_audio.vab_id = -1;
                     current_state = STATE_VAB_VH_SELECT;
                     cursor = selected_vh;
                     menu_cursor = 0;
@@ -1852,10 +4695,15 @@ void processInput(void)
                 hold_active_down = 0;
             }
             
-            // X button - Enter program edit if on PROGRAM_EDIT menu item
+            // X button - Enter program edit if on PROGRAM_EDIT menu item,
+            // hold the chord at NOTE, or release the held notes on CHORD
             if (pad & PADRdown && !(oldpad & PADRdown)) {
                 if (menu_cursor == VAB_MENU_PROGRAM_EDIT) {
                     enterProgramEdit();
+                } else if (menu_cursor == VAB_MENU_NOTE) {
+                    auditionChord(1);
+                } else if (menu_cursor == VAB_MENU_CHORD) {
+                    auditionReleaseAll();
                 }
             }
             
@@ -1926,6 +4774,11 @@ void processInput(void)
             break;
             
         case STATE_PROGRAM_EDIT:
+            // Select+X - Save the soundbank's edits to the memory card
+            if ((pad & PADselect) && pad & PADRdown && !(oldpad & PADRdown)) {
+                editSave(selected_vh);
+            }
+            
             // If Select is held, skip all normal inputs (layer modifier)
             if (!select_layer_active) {
                 // Circle - Back to playback
@@ -2071,6 +4924,10 @@ void processInput(void)
                         edit_tone = 0;
                         loadToneData();
                     }
+                    if (pad & PADRdown && !(oldpad & PADRdown)) {
+                        // Save the soundbank's edits to the memory card
+                        editSave(selected_vh);
+                    }
                 }
                 
                 // All other normal inputs (wrapped - disabled when Select held)
@@ -2334,6 +5191,16 @@ void processInput(void)
     oldpad = pad;
 }
 
+// First row of a file list shown with the cursor on screen
+int listTop(int count)
+{
+    int top = cursor - LIST_ROWS / 2;
+    
+    if (top > count - LIST_ROWS) top = count - LIST_ROWS;
+    if (top < 0) top = 0;
+    return top;
+}
+
 void drawSeqSelect(void)
 {
     int i;
@@ -2342,17 +5209,28 @@ void drawSeqSelect(void)
     FntPrint("=== SELECT SEQUENCE FILE ===\n\n");
     FntPrint("Available SEQ files:\n\n");
     
-    for (i = 0; i < MAX_SEQ_FILES; i++) {
-        if (i == cursor) {
-            FntPrint("> %s\n", seq_files[i].name);
-        } else {
-            FntPrint("  %s\n", seq_files[i].name);
-        }
+    for (i = listTop(num_seq_files); i < num_seq_files && i < listTop(num_seq_files) + LIST_ROWS; i++) {
+        FntPrint("%s %s%s\n", i == cursor ? ">" : " ", seq_files[i].name, seq_files[i].hot ? " +" : "");
     }
     
     FntPrint("\n");
+    if (pak_bad_files) {
+        FntPrint("%d damaged files left out\n", pak_bad_files);
+    }
+    if (pakCount(ASSET_PAK) < 0) {
+        FntPrint("assets.pak is missing or invalid\n");
+    }
+#if CD_ASSETS
+    if (pakCount(STREAM_PAK) < 0) {
+        FntPrint("DISC.PAK not found on the CD\n");
+    }
+#endif
+    if (hot_count) {
+        FntPrint("+ received over serial\n");
+    }
     FntPrint("X: Select (SEQ Mode)\n");
     FntPrint("Square: SOUNDBANK Mode\n");
+    FntPrint("Triangle: Receive over serial\n");
 }
 
 void drawVhSelect(void)
@@ -2364,19 +5242,29 @@ void drawVhSelect(void)
     FntPrint("Selected SEQ: %s\n\n", seq_files[selected_seq].name);
     FntPrint("Available VH files:\n\n");
     
-    for (i = 0; i < MAX_VH_FILES; i++) {
-        if (i == cursor) {
-            FntPrint("> %s\n", vh_files[i].name);
-        } else {
-            FntPrint("  %s\n", vh_files[i].name);
-        }
+    for (i = listTop(num_vh_files); i < num_vh_files && i < listTop(num_vh_files) + LIST_ROWS; i++) {
+        FntPrint("%s %s%s%s\n", i == cursor ? ">" : " ", vh_files[i].name, vabCacheFind(i) >= 0 ? " *" : "",
+                 vh_files[i].hot ? " +" : "");
     }
     
-    FntPrint("\n");
+    FntPrint("\n* in SPU RAM (%dK of %dK)\n", vabCacheUsed() >> 10, (SPU_RAM_END - SPU_RAM_BASE) >> 10);
+    FntPrint("Loads %d hits %d evicted %d\n\n", vab_cache_loads, vab_cache_hits, vab_cache_evictions);
     FntPrint("X: Select\n");
     FntPrint("Circle: Back\n");
 }
 
+const char* formatSongTime(u_int tick)
+{
+    static char text[24];
+    u_int now = seqTickToMs(current_audio.song, seq_tempo_map, seq_num_tempos, tick);
+    u_int total = seqTickToMs(current_audio.song, seq_tempo_map, seq_num_tempos, current_audio.song->end_tick);
+    
+    now = (u_int)(((unsigned long long)now * song_tempo) / current_tempo) / 1000;
+    total = (u_int)(((unsigned long long)total * song_tempo) / current_tempo) / 1000;
+    sprintf(text, "%d:%02d/%d:%02d", now / 60, now % 60, total / 60, total % 60);
+    return text;
+}
+
 void drawPlayback(void)
 {
     const char* status_text;
@@ -2395,7 +5283,19 @@ void drawPlayback(void)
     } else {
         status_text = "STOPPED";
     }
-    FntPrint("Status: %s\n\n", status_text);
+    if (is_playing && seq_num_tempos > 0) {
+        // Song time scaled by the menu tempo
+        FntPrint("Status: %s %s\n", status_text, formatSongTime(seq_player.tick));
+    } else {
+        FntPrint("Status: %s\n", status_text);
+    }
+#if SEQ_TICK_RCNT
+    FntPrint("Clock: %dHz Tick: %dus (max %dus)\n", SEQ_TICK_RATE,
+             RCNT2_TO_US(tick_cost_last), RCNT2_TO_US(tick_cost_max));
+#endif
+    FntPrint("Voices: %d peak %d steal %d drop %d\n", voice_active, voice_peak,
+             voice_steals, voice_refused);
+    FntPrint("Key-ons: %lu in %lu KON writes\n\n", drv_keyons, drv_kon_writes);
     
     // Menu items
     FntPrint("=== MENU ===\n");
@@ -2424,18 +5324,27 @@ void drawPlayback(void)
     // TEMPO
     if (menu_cursor == MENU_TEMPO) {
         if (tempo_changed) {
-            FntPrint("> TEMPO: %d\n", current_tempo);
+            FntPrint("> TEMPO: %d (%d%%) X:Reset\n", current_tempo, (current_tempo * 100) / song_tempo);
         } else {
-            FntPrint("> TEMPO: unchanged (X)\n");
+            FntPrint("> TEMPO: %d (song)\n", current_tempo);
         }
     } else {
         if (tempo_changed) {
-            FntPrint("  TEMPO: %d\n", current_tempo);
+            FntPrint("  TEMPO: %d (%d%%)\n", current_tempo, (current_tempo * 100) / song_tempo);
         } else {
-            FntPrint("  TEMPO: unchanged\n");
+            FntPrint("  TEMPO: %d (song)\n", current_tempo);
         }
     }
     
+    // SEEK (bar position, 1-based)
+    if (is_playing) {
+        FntPrint("%s SEEK: bar %d/%d\n", (menu_cursor == MENU_SEEK) ? ">" : " ",
+                 seq_player.tick / seqBarTicks(current_audio.song) + 1,
+                 current_audio.song->end_tick / seqBarTicks(current_audio.song) + 1);
+    } else {
+        FntPrint("%s SEEK: -\n", (menu_cursor == MENU_SEEK) ? ">" : " ");
+    }
+    
     // REVERB TYPE
     if (menu_cursor == MENU_REV_TYPE) {
         FntPrint("> REV TYPE: %s\n", getReverbTypeName(reverb_type));
@@ -2477,7 +5386,42 @@ void drawPlayback(void)
     FntPrint("Start: Toggle Pause\n");
     FntPrint("L/R:-1/+1 L1/R1:-10+10\n");
     FntPrint("Square: Min/Max\n");
-    FntPrint("Circle: Back\n");
+    FntPrint("Circle: Back R2: Voices\n");
+}
+
+void drawVoiceMonitor(void)
+{
+    int v;
+    char state;
+    
+    readSpuVoices();
+    
+    FntPrint("\n");
+    // Held/sounding voices, then the peaks since the last reset
+    FntPrint("VOICES %d/%d peak %d/%d Sq:Rst O:Back\n", voice_active, spu_snapshot.sounding,
+             voice_peak, spu_snapshot.sounding_peak);
+    FntPrint("Steal %d Drop %d ENDX %06x\n", voice_steals, voice_refused, spu_snapshot.endx);
+    FntPrint("V  S ENV  PTCH VOLL VOLR PG:TN REL\n");
+    
+    for (v = 0; v < SPU_NUM_VOICES; v++) {
+        // H = held, R = released, - = free; lower case when the envelope is at zero
+        switch (voice_state[v]) {
+            case VOICE_HELD:     state = 'H'; break;
+            case VOICE_RELEASED: state = 'R'; break;
+            default:             state = '-'; break;
+        }
+        if (spu_snapshot.env[v] == 0 && state != '-') state += 'a' - 'A';
+        
+        if (voice_state[v] == VOICE_FREE && spu_snapshot.env[v] == 0) {
+            FntPrint("%2d %c\n", v, state);
+        } else {
+            FntPrint("%2d %c %04x %04x %04x %04x %3d:%-2d%4d\n", v, state,
+                     spu_snapshot.env[v], spu_snapshot.pitch[v],
+                     spu_snapshot.vol_l[v], spu_snapshot.vol_r[v],
+                     seq_voices[v].program, seq_voices[v].tone,
+                     spu_snapshot.release_frames[v]);
+        }
+    }
 }
 
 void drawVabVhSelect(void)
@@ -2488,19 +5432,75 @@ void drawVabVhSelect(void)
     FntPrint("=== SOUNDBANK MODE ===\n\n");
     FntPrint("Available VH files:\n\n");
     
-    for (i = 0; i < MAX_VH_FILES; i++) {
-        if (i == cursor) {
-            FntPrint("> %s\n", vh_files[i].name);
-        } else {
-            FntPrint("  %s\n", vh_files[i].name);
-        }
+    for (i = listTop(num_vh_files); i < num_vh_files && i < listTop(num_vh_files) + LIST_ROWS; i++) {
+        FntPrint("%s %s%s%s\n", i == cursor ? ">" : " ", vh_files[i].name, vabCacheFind(i) >= 0 ? " *" : "",
+                 vh_files[i].hot ? " +" : "");
     }
     
-    FntPrint("\n");
+    FntPrint("\n* in SPU RAM (%dK of %dK)\n", vabCacheUsed() >> 10, (SPU_RAM_END - SPU_RAM_BASE) >> 10);
+    FntPrint("Loads %d hits %d evicted %d\n\n", vab_cache_loads, vab_cache_hits, vab_cache_evictions);
     FntPrint("X: Select\n");
     FntPrint("Circle: Back to Mode Select\n");
 }
 
+void drawVabLoading(void)
+{
+    char bar[21];
+    u_long sent = 0, size = 1;
+    int i, filled;
+    
+    if (vab_load_slot >= 0) {
+        sent = vab_cache[vab_load_slot].sent;
+        size = vab_cache[vab_load_slot].size;
+    }
+    filled = size ? (int)(sent * 20 / size) : 20;
+    for (i = 0; i < 20; i++) {
+        bar[i] = i < filled ? '#' : '.';
+    }
+    bar[20] = 0;
+    
+    FntPrint("\n");
+    FntPrint("=== LOADING SOUNDBANK ===\n\n");
+    FntPrint("%s\n\n", vh_files[selected_vh].name);
+    FntPrint("[%s] %d%%\n", bar, size ? (int)(sent * 100 / size) : 100);
+    FntPrint("%dK of %dK\n\n", sent >> 10, size >> 10);
+#if CD_ASSETS
+    if (cd_retries) FntPrint("CD read retries: %d\n\n", cd_retries);
+#endif
+    FntPrint("Circle: Cancel\n");
+}
+
+void drawHotLoad(void)
+{
+    char bar[21];
+    u_long size = hot_header.size ? hot_header.size : 1;
+    int i, filled;
+    
+    FntPrint("\n");
+    FntPrint("=== RECEIVE OVER SERIAL ===\n\n");
+    FntPrint("On the host:\n");
+    FntPrint("tools/hotload port file...\n");
+    FntPrint("(%d baud 8N1)\n\n", HOT_BAUD);
+    
+    if (hot_phase == HOT_PHASE_CHUNK_HEAD || hot_phase == HOT_PHASE_CHUNK) {
+        filled = (int)(hot_received * 20 / size);
+        for (i = 0; i < 20; i++) {
+            bar[i] = i < filled ? '#' : '.';
+        }
+        bar[20] = 0;
+        FntPrint("Receiving %s\n", hot_header.name);
+        FntPrint("[%s] %d%%\n", bar, (int)(hot_received * 100 / size));
+        FntPrint("%dK of %dK\n\n", hot_received >> 10, hot_header.size >> 10);
+    } else {
+        FntPrint("Waiting\n\n\n\n");
+    }
+    
+    FntPrint("%s\n\n", hot_status);
+    FntPrint("Received %d files (%dK of %dK)\n", hot_count, hot_used >> 10, HOT_RAM_SIZE >> 10);
+    FntPrint("Retries %d lost bytes %d\n\n", hot_retries, sio_overruns);
+    FntPrint("Circle: Back\n");
+}
+
 void drawVabPlayback(void)
 {
     const char* note_names[] = {"C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B"};
@@ -2513,11 +5513,12 @@ void drawVabPlayback(void)
     FntPrint("Programs: %d\n", current_audio.num_programs);
     FntPrint("Tones: %d\n\n", current_audio.num_tones);
     
-    if (note_playing) {
-        FntPrint("Status: PLAYING\n\n");
+    if (audition_count > 0) {
+        FntPrint("Status: PLAYING %d notes (%d held)\n", audition_count, audition_latched);
     } else {
-        FntPrint("Status: STOPPED\n\n");
+        FntPrint("Status: STOPPED\n");
     }
+    FntPrint("Voices: %d peak %d steal %d\n\n", voice_active, voice_peak, voice_steals);
     
     // Menu items
     FntPrint("=== MENU ===\n");
@@ -2536,6 +5537,13 @@ void drawVabPlayback(void)
         FntPrint("  PROGRAM: %d\n", current_program);
     }
     
+    // CHORD
+    if (menu_cursor == VAB_MENU_CHORD) {
+        FntPrint("> CHORD: %s (X:Release)\n", audition_chords[audition_chord].name);
+    } else {
+        FntPrint("  CHORD: %s\n", audition_chords[audition_chord].name);
+    }
+    
     // REVERB TYPE
     if (menu_cursor == VAB_MENU_REV_TYPE) {
         FntPrint("> REV TYPE: %s\n", getReverbTypeName(reverb_type));
@@ -2571,8 +5579,13 @@ void drawVabPlayback(void)
         FntPrint("  PROGRAM EDIT\n");
     }
     
+#if PROFILE_FRAME
+    FntPrint("Key on: %luus (max %luus), %luus after pad\n", RCNT2_TO_US(keyon_cost),
+             RCNT2_TO_US(keyon_cost_max), RCNT2_TO_US(keyon_latency));
+#endif
+    
     FntPrint("\n=== CONTROLS ===\n");
-    FntPrint("Triangle: Play Note\n");
+    FntPrint("Triangle: Play  X on NOTE: Hold\n");
     FntPrint("L2/R2: Note +/-\n");
     FntPrint("L/R:-1/+1 L1/R1:-10+10\n");
     FntPrint("Square: Min/Max\n");
@@ -2663,6 +5676,10 @@ void drawProgramEdit(void)
         FntPrint("Start: Pause\n");
     }
     FntPrint("Circle: Back\n");
+    FntPrint("SEL+X: Save to memory card\n");
+    if (edit_status[0]) {
+        FntPrint("\n%s\n", edit_status);
+    }
 }
 
 void drawToneEdit(void)
@@ -2671,6 +5688,9 @@ void drawToneEdit(void)
     int octave, center_octave;
     const char* note_name;
     const char* center_note_name;
+    char note_tones[40];
+    char* out;
+    u_long mask;
     
     FntPrint("\n");
     FntPrint("=== TONE EDITOR ===  ");
@@ -2708,10 +5728,18 @@ void drawToneEdit(void)
     if (vab_mode) {
         octave = (current_note / 12) - 1;
         note_name = note_names[current_note % 12];
+        
+        // Tones the note plays
+        out = note_tones;
+        for (mask = drvNoteTones(edit_program, current_note); mask != 0; mask &= mask - 1) {
+            out += sprintf(out, out == note_tones ? "%d" : "+%d", lowestBit(mask));
+        }
+        if (out == note_tones) strcpy(note_tones, "-");
+        
         if (menu_cursor == TONE_MENU_NOTE_SEL) {
-            FntPrint("> NOTE: %d (%s%d)\n", current_note, note_name, octave);
+            FntPrint("> NOTE: %d (%s%d) T:%s\n", current_note, note_name, octave, note_tones);
         } else {
-            FntPrint("  NOTE: %d (%s%d)\n", current_note, note_name, octave);
+            FntPrint("  NOTE: %d (%s%d) T:%s\n", current_note, note_name, octave, note_tones);
         }
     }
     
@@ -2837,11 +5865,110 @@ void drawToneEdit(void)
             FntPrint("Start: Pause\n");
         }
         FntPrint("Circle: Back\n");
+        if (edit_status[0]) {
+            FntPrint("%s\n", edit_status);
+        } else {
+            FntPrint("SEL+X: Save to memory card\n");
+        }
+    }
+}
+
+// Time the phases of an ADSR setting and plot each over its own length.
+// The release starts from the end of the decay, where spuEnvTimes times it,
+// so it ends with the time shown next to RELEASE RATE
+void buildAdsrCurve(u_short adsr1, u_short adsr2)
+{
+    SpuEnvelope env, decay_end;
+    u_long span[4];
+    u_long step;
+    short* points = adsr_curve;
+    int phase, n;
+    
+    spuEnvTimes(adsr1, adsr2, &adsr_times);
+    span[0] = adsr_times.attack;
+    span[1] = adsr_times.decay;
+    span[2] = adsr_times.sustain;
+    span[3] = adsr_times.release;
+    
+    spuEnvKeyOn(&env, adsr1, adsr2);
+    for (phase = 0; phase < 4; phase++) {
+        // The next phase from where it starts, even if this one never ends
+        if (phase == 1 && env.phase == ENV_ATTACK) {
+            env.phase = ENV_DECAY;
+            env.level = SPU_ENV_MAX;
+            env.counter = 0;
+        }
+        if (phase == 2 && env.phase == ENV_DECAY) {
+            env.phase = ENV_SUSTAIN;
+            env.counter = 0;
+        }
+        if (phase == 2) decay_end = env;
+        if (phase == 3) {
+            env = decay_end;
+            spuEnvKeyOff(&env);
+        }
+        
+        if (span[phase] == SPU_ENV_NEVER || span[phase] == 0) span[phase] = ADSR_CURVE_HOLD;
+        step = (span[phase] + ADSR_CURVE_W - 2) / (ADSR_CURVE_W - 1);
+        n = spuEnvPlot(&env, step, points, ADSR_CURVE_W);
+        for (; n < ADSR_CURVE_W; n++) {
+            points[n] = points[n - 1];
+        }
+        points += ADSR_CURVE_W;
+    }
+    
+    adsr_curve_adsr1 = adsr1;
+    adsr_curve_adsr2 = adsr2;
+    adsr_curve_valid = 1;
+}
+
+void drawAdsrCurve(void)
+{
+    LINE_F2 line;
+    int i, x, y, last_y;
+    
+    SetLineF2(&line);
+    
+    // Zero level and phase boundaries
+    setRGB0(&line, 96, 96, 96);
+    setXY2(&line, ADSR_CURVE_X, ADSR_CURVE_Y + ADSR_CURVE_H,
+           ADSR_CURVE_X + 4 * ADSR_CURVE_W - 1, ADSR_CURVE_Y + ADSR_CURVE_H);
+    DrawPrim(&line);
+    for (i = 1; i < 4; i++) {
+        x = ADSR_CURVE_X + i * ADSR_CURVE_W;
+        setXY2(&line, x, ADSR_CURVE_Y, x, ADSR_CURVE_Y + ADSR_CURVE_H);
+        DrawPrim(&line);
+    }
+    
+    setRGB0(&line, 255, 224, 96);
+    last_y = ADSR_CURVE_Y + ADSR_CURVE_H - adsr_curve[0] * ADSR_CURVE_H / SPU_ENV_MAX;
+    for (i = 1; i < 4 * ADSR_CURVE_W; i++) {
+        x = ADSR_CURVE_X + i;
+        y = ADSR_CURVE_Y + ADSR_CURVE_H - adsr_curve[i] * ADSR_CURVE_H / SPU_ENV_MAX;
+        setXY2(&line, x - 1, last_y, x, y);
+        DrawPrim(&line);
+        last_y = y;
+    }
+}
+
+// Envelope phase length for the ADSR editor ("--" if it never ends)
+void formatEnvTime(char* out, u_long samples)
+{
+    if (samples == SPU_ENV_NEVER) {
+        strcpy(out, "--");
+    } else if (samples < SPU_ENV_RATE) {
+        sprintf(out, "%lums", samples * 1000 / SPU_ENV_RATE);
+    } else if (samples < 10 * SPU_ENV_RATE) {
+        sprintf(out, "%lu.%lus", samples / SPU_ENV_RATE, samples / (SPU_ENV_RATE / 10) % 10);
+    } else {
+        sprintf(out, "%lus", samples / SPU_ENV_RATE);
     }
 }
 
 void drawAdsrEdit(void)
 {
+    char attack[8], decay[8], sustain[8], release[8];
+    
     FntPrint("\n");
     FntPrint("=== ADSR EDIT ===\n\n");
     
@@ -2851,14 +5978,24 @@ void drawAdsrEdit(void)
     FntPrint("ADSR1: 0x%04X\n", temp_adsr1);
     FntPrint("ADSR2: 0x%04X\n\n", temp_adsr2);
     
+    // Curve and phase lengths, rebuilt only when the setting changes
+    if (!adsr_curve_valid || temp_adsr1 != adsr_curve_adsr1 || temp_adsr2 != adsr_curve_adsr2) {
+        buildAdsrCurve(temp_adsr1, temp_adsr2);
+    }
+    drawAdsrCurve();
+    formatEnvTime(attack, adsr_times.attack);
+    formatEnvTime(decay, adsr_times.decay);
+    formatEnvTime(sustain, adsr_times.sustain);
+    formatEnvTime(release, adsr_times.release);
+    
     FntPrint("=== PARAMETERS ===\n");
     
     // Attack Rate
     if (menu_cursor == ADSR_MENU_ATTACK_RATE) {
-        FntPrint("> ATTACK RATE: %d%s\n", current_adsr.attack,
+        FntPrint("> ATTACK RATE: %d (%s)%s\n", current_adsr.attack, attack,
                  isAdsrValueChanged(ADSR_MENU_ATTACK_RATE) ? " !" : "");
     } else {
-        FntPrint("  ATTACK RATE: %d%s\n", current_adsr.attack,
+        FntPrint("  ATTACK RATE: %d (%s)%s\n", current_adsr.attack, attack,
                  isAdsrValueChanged(ADSR_MENU_ATTACK_RATE) ? " !" : "");
     }
     
@@ -2873,10 +6010,10 @@ void drawAdsrEdit(void)
     
     // Decay Rate
     if (menu_cursor == ADSR_MENU_DECAY_RATE) {
-        FntPrint("> DECAY RATE: %d%s\n", current_adsr.decay,
+        FntPrint("> DECAY RATE: %d (%s)%s\n", current_adsr.decay, decay,
                  isAdsrValueChanged(ADSR_MENU_DECAY_RATE) ? " !" : "");
     } else {
-        FntPrint("  DECAY RATE: %d%s\n", current_adsr.decay,
+        FntPrint("  DECAY RATE: %d (%s)%s\n", current_adsr.decay, decay,
                  isAdsrValueChanged(ADSR_MENU_DECAY_RATE) ? " !" : "");
     }
     
@@ -2891,10 +6028,10 @@ void drawAdsrEdit(void)
     
     // Sustain Rate
     if (menu_cursor == ADSR_MENU_SUSTAIN_RATE) {
-        FntPrint("> SUSTAIN RATE: %d%s\n", current_adsr.sustain,
+        FntPrint("> SUSTAIN RATE: %d (%s)%s\n", current_adsr.sustain, sustain,
                  isAdsrValueChanged(ADSR_MENU_SUSTAIN_RATE) ? " !" : "");
     } else {
-        FntPrint("  SUSTAIN RATE: %d%s\n", current_adsr.sustain,
+        FntPrint("  SUSTAIN RATE: %d (%s)%s\n", current_adsr.sustain, sustain,
                  isAdsrValueChanged(ADSR_MENU_SUSTAIN_RATE) ? " !" : "");
     }
     
@@ -2918,10 +6055,10 @@ void drawAdsrEdit(void)
     
     // Release Rate
     if (menu_cursor == ADSR_MENU_RELEASE_RATE) {
-        FntPrint("> RELEASE RATE: %d%s\n", current_adsr.release,
+        FntPrint("> RELEASE RATE: %d (%s)%s\n", current_adsr.release, release,
                  isAdsrValueChanged(ADSR_MENU_RELEASE_RATE) ? " !" : "");
     } else {
-        FntPrint("  RELEASE RATE: %d%s\n", current_adsr.release,
+        FntPrint("  RELEASE RATE: %d (%s)%s\n", current_adsr.release, release,
                  isAdsrValueChanged(ADSR_MENU_RELEASE_RATE) ? " !" : "");
     }
     
@@ -2958,6 +6095,7 @@ void drawAdsrEdit(void)
     FntPrint("Circle: Cancel\n");
 }
 
+#if HAS_BACKGROUND_IMAGE
 // In drawBackground() - Fix UV coordinates for 320x240:
 void drawBackground(void)
 {
@@ -3063,6 +6201,7 @@ void drawBackground(void)
         DrawPrim(&bg_poly_right);
     }
 }
+#endif
 
 void drawUI(void)
 {
@@ -3098,6 +6237,15 @@ void drawUI(void)
         case STATE_ADSR_EDIT:
             drawAdsrEdit();
             break;
+        case STATE_VOICE_MONITOR:
+            drawVoiceMonitor();
+            break;
+        case STATE_VAB_LOADING:
+            drawVabLoading();
+            break;
+        case STATE_HOT_LOAD:
+            drawHotLoad();
+            break;
     }
 }
 
@@ -3106,21 +6254,35 @@ int main(void)
     // Initialize
     initGraph();
     initSound();
+    spuEnvInit();
     PadInit(0);
+    cardInit();
     
     // Load file information
     loadAudioFiles();
     
+#if PROFILE_FRAME
+    profReset();
+#endif
+    
     // Main loop
     while (1)
     {
         processInput();
+        vabAttrFlush();
+        PROF_MARK(PROF_INPUT);
         
 		#if HAS_BACKGROUND_IMAGE
 				drawBackground();  // Draw background image first if enabled
 		#endif
+        PROF_MARK(PROF_BACKGROUND);
 				
 				drawUI();
+        PROF_MARK(PROF_UI);
+		#if PROFILE_FRAME
+				drawProfiler();
+		#endif
+        PROF_MARK(PROF_OVERLAY);
 				
 		#if HAS_BACKGROUND_IMAGE
 				// Only flush font buffer when not in full image mode
@@ -3130,13 +6292,15 @@ int main(void)
 		#else
 				FntFlush(-1);
 		#endif
+        PROF_MARK(PROF_FLUSH);
         
         display();
+		#if PROFILE_FRAME
+        profEndFrame();
+		#endif
         
-        //ONLY USE THIS COMMAND IF NOTICK IS ENABLED
-		//otherwise everything plays fast
-
-        //SsSeqCalledTbyT();
+        // The sequencer tick is not called here: with SEQ_TICK_RCNT it runs from
+        // soundTickHandler() so a slow frame cannot delay note events
     }
     
     return 0;
@@ -0,0 +1,233 @@
+// SPU ADSR envelope (see spu_env.h)
+
+#include <sys/types.h>
+#include "spu_env.h"
+
+// Per 7-bit rate (shift in bits 6-2, step in bits 1-0): samples between level
+// changes, and the change when increasing and decreasing
+static u_long env_cycles[128];
+static short env_inc[128];
+static short env_dec[128];
+
+void spuEnvInit(void)
+{
+    int rate, shift;
+    
+    for (rate = 0; rate < 128; rate++) {
+        shift = rate >> 2;
+        env_cycles[rate] = 1 << (shift > 11 ? shift - 11 : 0);
+        env_inc[rate] = (7 - (rate & 3)) * (1 << (shift < 11 ? 11 - shift : 0));
+        env_dec[rate] = (-8 + (rate & 3)) * (1 << (shift < 11 ? 11 - shift : 0));
+    }
+}
+
+// Rate, direction and curve of the envelope's phase
+static void envPhase(const SpuEnvelope* env, int* rate, int* decrease, int* exponential)
+{
+    u_short adsr1 = env->adsr1;
+    u_short adsr2 = env->adsr2;
+    
+    switch (env->phase) {
+        case ENV_ATTACK:
+            *rate = (adsr1 >> 8) & 0x7F;
+            *decrease = 0;
+            *exponential = adsr1 >> 15;
+            break;
+        case ENV_DECAY:
+            *rate = ((adsr1 >> 4) & 0x0F) << 2;
+            *decrease = 1;
+            *exponential = 1;
+            break;
+        case ENV_SUSTAIN:
+            *rate = (adsr2 >> 6) & 0x7F;
+            *decrease = (adsr2 >> 14) & 1;
+            *exponential = adsr2 >> 15;
+            break;
+        default:
+            *rate = (adsr2 & 0x1F) << 2;
+            *decrease = 1;
+            *exponential = (adsr2 >> 5) & 1;
+            break;
+    }
+}
+
+static int envSustainLevel(const SpuEnvelope* env)
+{
+    return ((env->adsr1 & 0x0F) + 1) << 11;
+}
+
+// Level change at the current level, and the samples until the next one
+static int envChange(const SpuEnvelope* env, int rate, int decrease, int exponential, u_long* cycles)
+{
+    *cycles = env_cycles[rate];
+    if (!decrease) {
+        if (exponential && env->level > 0x6000) *cycles <<= 2;
+        return env_inc[rate];
+    }
+    return exponential ? (env_dec[rate] * env->level) >> 15 : env_dec[rate];
+}
+
+// Change the level, then check for the end of the phase
+static void envApply(SpuEnvelope* env, int adj)
+{
+    env->level += adj;
+    if (env->level > SPU_ENV_MAX) env->level = SPU_ENV_MAX;
+    if (env->level < 0) env->level = 0;
+    
+    switch (env->phase) {
+        case ENV_ATTACK:
+            if (env->level >= SPU_ENV_MAX) {
+                env->phase = ENV_DECAY;
+                env->counter = 0;
+            }
+            break;
+        case ENV_DECAY:
+            if (env->level <= envSustainLevel(env)) {
+                env->phase = ENV_SUSTAIN;
+                env->counter = 0;
+            }
+            break;
+        case ENV_RELEASE:
+            if (env->level == 0) {
+                env->phase = ENV_OFF;
+            }
+            break;
+    }
+}
+
+void spuEnvKeyOn(SpuEnvelope* env, u_short adsr1, u_short adsr2)
+{
+    env->phase = ENV_ATTACK;
+    env->level = 0;
+    env->counter = 0;
+    env->adsr1 = adsr1;
+    env->adsr2 = adsr2;
+}
+
+void spuEnvKeyOff(SpuEnvelope* env)
+{
+    if (env->phase != ENV_OFF) {
+        env->phase = ENV_RELEASE;
+        env->counter = 0;
+    }
+}
+
+void spuEnvStep(SpuEnvelope* env)
+{
+    int rate, decrease, exponential, adj;
+    u_long cycles;
+    
+    if (env->phase == ENV_OFF) return;
+    if (--env->counter > 0) return;
+    
+    envPhase(env, &rate, &decrease, &exponential);
+    adj = envChange(env, rate, decrease, exponential, &cycles);
+    env->counter = cycles;
+    envApply(env, adj);
+}
+
+// Changes are applied in runs that keep the same change and wait: up to the
+// phase's end, a clamp, the exponential attack's slowdown above 0x6000, or a
+// new exponential decrease (a decrease of n lasts while level * rate step
+// >> 15 is n). Exponential decreases with a slow rate take 8 runs, not
+// thousands of changes
+u_long spuEnvRun(SpuEnvelope* env, u_long samples)
+{
+    int phase = env->phase;
+    int rate, decrease, exponential, adj, edge, room, low;
+    u_long used = 0, cycles, runs, fit;
+    
+    if (phase == ENV_OFF) return 0;
+    envPhase(env, &rate, &decrease, &exponential);
+    
+    while (used < samples && env->phase == phase) {
+        // Only the sustain phase can stop changing the level (the release
+        // phase still ends with a change at level 0)
+        adj = envChange(env, rate, decrease, exponential, &cycles);
+        if (phase == ENV_SUSTAIN && (adj == 0 || (adj > 0 && env->level >= SPU_ENV_MAX) ||
+                                     (adj < 0 && env->level <= 0))) break;
+    
+        // Wait for the next change
+        if (env->counter > 1) {
+            fit = env->counter - 1;
+            if (fit > samples - used) fit = samples - used;
+            env->counter -= fit;
+            used += fit;
+            continue;
+        }
+    
+        // Changes before the one that may end the run (edge is the furthest
+        // level they can reach)
+        if (adj > 0) {
+            edge = (exponential && env->level <= 0x6000) ? 0x6000 : SPU_ENV_MAX - 1;
+            room = (edge - env->level) / adj;
+        } else {
+            edge = (phase == ENV_DECAY) ? envSustainLevel(env) + 1 : 1;
+            if (exponential) {
+                low = (32768 * (-adj - 1)) / -env_dec[rate] + 1;
+                if (low > edge) edge = low;
+            }
+            room = env->level > edge ? (env->level - edge) / -adj : 0;
+        }
+        if (room < 0) room = 0;
+    
+        // Change now, then every cycles samples
+        runs = room + 1;
+        fit = (samples - used - 1) / cycles + 1;
+        if (runs > fit) runs = fit;
+        env->level += (int)(runs - 1) * adj;
+        used += 1 + (runs - 1) * cycles;
+        env->counter = cycles;
+        envApply(env, adj);
+    }
+    return used;
+}
+
+// Samples to the end of the phase, SPU_ENV_NEVER if it does not end
+static u_long envPhaseTime(SpuEnvelope* env)
+{
+    int phase = env->phase;
+    u_long time = spuEnvRun(env, SPU_ENV_NEVER);
+    
+    return env->phase != phase ? time : SPU_ENV_NEVER;
+}
+
+void spuEnvTimes(u_short adsr1, u_short adsr2, SpuEnvTimes* times)
+{
+    SpuEnvelope env, release;
+    
+    spuEnvKeyOn(&env, adsr1, adsr2);
+    times->attack = envPhaseTime(&env);
+    
+    // Later phases from where they start, even after an attack that never ends
+    env.phase = ENV_DECAY;
+    env.level = SPU_ENV_MAX;
+    env.counter = 0;
+    times->decay = envPhaseTime(&env);
+    if (env.phase == ENV_DECAY) {
+        env.phase = ENV_SUSTAIN;
+        env.counter = 0;
+    }
+    times->sustain_level = env.level;
+    
+    release = env;
+    spuEnvKeyOff(&release);
+    times->release = envPhaseTime(&release);
+    
+    // The sustain phase only ends at a key-off, so it is timed to where the
+    // level settles at silence or full level
+    times->sustain = spuEnvRun(&env, SPU_ENV_NEVER);
+}
+
+int spuEnvPlot(SpuEnvelope* env, u_long step, short* levels, int count)
+{
+    int phase = env->phase;
+    int i;
+    
+    for (i = 0; i < count; i++) {
+        levels[i] = env->level;
+        if (env->phase != phase) return i + 1;
+        spuEnvRun(env, step);
+    }
+    return count;
+}
@@ -0,0 +1,57 @@
+// SPU ADSR envelope
+// The envelope of one voice, stepped a sample at a time by the host SPU model
+// (tools/spu.c), and the same rules run a level change at a time to time the
+// phases of an ADSR setting and plot its curve (the player's ADSR editor).
+// The level change and wait of every rate come from tables built by
+// spuEnvInit.
+//
+// Shared by the player and the host tools, so only plain C and sys/types.h
+
+#ifndef SPU_ENV_H
+#define SPU_ENV_H
+
+#define SPU_ENV_RATE 44100       // Envelope steps per second (one per output sample)
+#define SPU_ENV_MAX 0x7FFF       // Full level
+#define SPU_ENV_NEVER 0xFFFFFFFF // Duration of a phase that does not end (or ends after ~27 hours)
+
+// Envelope phases
+#define ENV_OFF 0
+#define ENV_ATTACK 1
+#define ENV_DECAY 2
+#define ENV_SUSTAIN 3
+#define ENV_RELEASE 4
+
+typedef struct {
+    int phase;               // ENV_*
+    int level;               // 0-SPU_ENV_MAX
+    int counter;             // Samples until the next level change
+    u_short adsr1, adsr2;
+} SpuEnvelope;
+
+// Phase durations of an ADSR setting in samples (SPU_ENV_RATE)
+typedef struct {
+    u_long attack;           // Key-on to full level
+    u_long decay;            // Full level to the sustain level
+    u_long sustain;          // Until the sustain phase stops changing the level
+    u_long release;          // To silence, keyed off at the end of the decay
+    int sustain_level;       // Level the decay ends at
+} SpuEnvTimes;
+
+// Rate tables, before anything else here is used
+void spuEnvInit(void);
+
+void spuEnvKeyOn(SpuEnvelope* env, u_short adsr1, u_short adsr2);
+void spuEnvKeyOff(SpuEnvelope* env);
+void spuEnvStep(SpuEnvelope* env);
+
+// Run up to samples spuEnvSteps at once, stopping where the phase ends or the
+// level stops changing. Returns the samples run
+u_long spuEnvRun(SpuEnvelope* env, u_long samples);
+
+void spuEnvTimes(u_short adsr1, u_short adsr2, SpuEnvTimes* times);
+
+// Level every step samples into levels, up to count points, until the point
+// where the phase ends. Returns the points written
+int spuEnvPlot(SpuEnvelope* env, u_long step, short* levels, int count);
+
+#endif // SPU_ENV_H
@@ -0,0 +1,174 @@
+// envbench - ADSR envelope run/step agreement and timing (spu_env.c)
+//
+// Usage: envbench
+//
+// spuEnvRun, which applies level changes a run at a time, must leave an
+// envelope where the same number of spuEnvSteps does, and spuEnvTimes must
+// give the phase lengths the stepped envelope takes. Both are checked with
+// random ADSR settings, key-off times and run lengths, then the time the
+// player's ADSR editor spends on a setting (times and curve) is measured.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/types.h>
+#include "../spu_env.h"
+
+#define BENCH_SECONDS 0.25          // Minimum time per measurement
+#define SETTINGS 2048
+#define CHECK_SAMPLES SPU_ENV_RATE  // Longest phase checked by stepping
+#define CURVE_POINTS 28             // Per phase, as in the player
+
+static double now(void)
+{
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static u_int randomNext(u_int* seed)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return *seed >> 16;
+}
+
+// Run env in random lengths next to a stepped copy. Returns 0 if they agree
+static int checkRun(u_short adsr1, u_short adsr2, u_int* seed)
+{
+    SpuEnvelope step, run;
+    u_long key_off = randomNext(seed) % CHECK_SAMPLES;
+    u_long t = 0, n, used, i;
+    int phase;
+    
+    spuEnvKeyOn(&step, adsr1, adsr2);
+    spuEnvKeyOn(&run, adsr1, adsr2);
+    while (t < 2 * CHECK_SAMPLES && run.phase != ENV_OFF) {
+        if (t >= key_off && run.phase != ENV_RELEASE) {
+            spuEnvKeyOff(&step);
+            spuEnvKeyOff(&run);
+        }
+        n = 1 + randomNext(seed) % (randomNext(seed) & 1 ? 64 : 16384);
+        if (t < key_off && t + n > key_off) n = key_off - t;
+    
+        phase = run.phase;
+        used = spuEnvRun(&run, n);
+        for (i = 0; i < used; i++) spuEnvStep(&step);
+    
+        // Stopped with the level settled: stepping must not change it either
+        if (used < n && run.phase == phase) {
+            for (; used < n; used++) spuEnvStep(&step);
+        }
+    
+        t += used;
+        if (step.level != run.level || step.phase != run.phase) {
+            printf("ADSR %04X %04X at sample %lu: stepped phase %d level %d, run phase %d level %d\n",
+                   adsr1, adsr2, t, step.phase, step.level, run.phase, run.level);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Samples a stepped envelope takes to leave its phase, or for the sustain
+// phase to reach silence or full level. CHECK_SAMPLES + 1 if longer
+static u_long stepTime(SpuEnvelope* env)
+{
+    int phase = env->phase;
+    u_long t;
+    
+    for (t = 1; t <= CHECK_SAMPLES; t++) {
+        spuEnvStep(env);
+        if (env->phase != phase) return t;
+        if (phase == ENV_SUSTAIN && (env->level == 0 || env->level == SPU_ENV_MAX)) return t;
+    }
+    return CHECK_SAMPLES + 1;
+}
+
+static int checkTime(const char* name, u_short adsr1, u_short adsr2, u_long expect, u_long got)
+{
+    if (expect > CHECK_SAMPLES ? got > CHECK_SAMPLES : got == expect) return 0;
+    printf("ADSR %04X %04X: %s takes %lu samples stepped, spuEnvTimes gives %lu\n", adsr1, adsr2, name,
+           expect, got);
+    return -1;
+}
+
+// Returns 0 if the phase lengths agree with stepping
+static int checkTimes(u_short adsr1, u_short adsr2)
+{
+    SpuEnvTimes times;
+    SpuEnvelope env;
+    int result = 0;
+    
+    spuEnvTimes(adsr1, adsr2, &times);
+    
+    spuEnvKeyOn(&env, adsr1, adsr2);
+    result |= checkTime("attack", adsr1, adsr2, stepTime(&env), times.attack);
+    
+    env.phase = ENV_DECAY;
+    env.level = SPU_ENV_MAX;
+    env.counter = 0;
+    result |= checkTime("decay", adsr1, adsr2, stepTime(&env), times.decay);
+    if (env.phase != ENV_SUSTAIN) return result;
+    
+    // Sustain settles at 0 or full level unless it starts there
+    if (env.level != 0 && env.level != SPU_ENV_MAX) {
+        SpuEnvelope sustain = env;
+        result |= checkTime("sustain", adsr1, adsr2, stepTime(&sustain), times.sustain);
+    }
+    
+    spuEnvKeyOff(&env);
+    result |= checkTime("release", adsr1, adsr2, stepTime(&env), times.release);
+    return result;
+}
+
+// What the player does when a setting changes: time the phases, plot each
+static void editorCurve(u_short adsr1, u_short adsr2)
+{
+    static short levels[CURVE_POINTS];
+    SpuEnvTimes times;
+    SpuEnvelope env, decay_end;
+    
+    spuEnvTimes(adsr1, adsr2, &times);
+    spuEnvKeyOn(&env, adsr1, adsr2);
+    spuEnvPlot(&env, times.attack / (CURVE_POINTS - 1) + 1, levels, CURVE_POINTS);
+    spuEnvPlot(&env, times.decay / (CURVE_POINTS - 1) + 1, levels, CURVE_POINTS);
+    decay_end = env;
+    spuEnvPlot(&env, SPU_ENV_RATE / (CURVE_POINTS - 1), levels, CURVE_POINTS);
+    spuEnvKeyOff(&decay_end);
+    spuEnvPlot(&decay_end, times.release / (CURVE_POINTS - 1) + 1, levels, CURVE_POINTS);
+}
+
+int main(void)
+{
+    static u_short adsr[SETTINGS][2];
+    u_int seed = 1;
+    u_long passes = 0;
+    double start, elapsed;
+    int failed = 0;
+    int i;
+    
+    spuEnvInit();
+    for (i = 0; i < SETTINGS; i++) {
+        adsr[i][0] = randomNext(&seed);
+        adsr[i][1] = randomNext(&seed);
+    }
+    
+    for (i = 0; i < SETTINGS && !failed; i++) {
+        if (checkRun(adsr[i][0], adsr[i][1], &seed) < 0) failed = 1;
+        if (checkTimes(adsr[i][0], adsr[i][1]) < 0) failed = 1;
+    }
+    printf("%d random ADSR settings: spuEnvRun and spuEnvTimes %s spuEnvStep\n", SETTINGS,
+           failed ? "DIFFER from" : "match");
+    
+    start = now();
+    do {
+        editorCurve(adsr[passes % SETTINGS][0], adsr[passes % SETTINGS][1]);
+        passes++;
+        elapsed = now() - start;
+    } while (elapsed < BENCH_SECONDS);
+    printf("editor curve: %.2f us per ADSR setting (times and %d points)\n", elapsed * 1e6 / passes,
+           CURVE_POINTS * 4);
+    
+    return failed;
+}
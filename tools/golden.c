@@ -0,0 +1,250 @@
+// Golden renders (see golden.h)
+
+#define _GNU_SOURCE
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include "golden.h"
+
+#define GOLDEN_MAGIC "# seqrender golden "
+#define GOLDEN_VERSION 2
+
+GoldenHash goldenHash(const void* data, u_int size, GoldenHash hash)
+{
+    const u_char* p = data;
+    u_int i;
+    
+    for (i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+int goldenMeasure(GoldenEntry* entry, const short* pcm, u_int frames)
+{
+    u_int w, f, first, last;
+    double sum;
+    u_char sample[2];
+    GoldenHash hash = GOLDEN_HASH_INIT;
+    GoldenHash window;
+    
+    entry->frames = frames;
+    entry->num_windows = (frames + GOLDEN_WINDOW_FRAMES - 1) / GOLDEN_WINDOW_FRAMES;
+    entry->rms = malloc((entry->num_windows + 1) * sizeof(u_short));
+    entry->window_hash = malloc((entry->num_windows + 1) * sizeof(u_int));
+    if (!entry->rms || !entry->window_hash) return -1;
+    
+    // Hash the samples as little-endian so goldens move between hosts
+    for (w = 0; w < (u_int)entry->num_windows; w++) {
+        first = w * GOLDEN_WINDOW_FRAMES;
+        last = first + GOLDEN_WINDOW_FRAMES < frames ? first + GOLDEN_WINDOW_FRAMES : frames;
+        sum = 0;
+        window = GOLDEN_HASH_INIT;
+        for (f = first * 2; f < last * 2; f++) {
+            sum += (double)pcm[f] * pcm[f];
+            sample[0] = (u_char)pcm[f];
+            sample[1] = (u_char)((u_short)pcm[f] >> 8);
+            hash = goldenHash(sample, 2, hash);
+            window = goldenHash(sample, 2, window);
+        }
+        entry->rms[w] = (u_short)(sqrt(sum / ((last - first) * 2)) + 0.5);
+        entry->window_hash[w] = (u_int)(window ^ (window >> 32));
+    }
+    entry->pcm_hash = hash;
+    
+    return 0;
+}
+
+int goldenAdd(GoldenSet* set, const GoldenEntry* entry)
+{
+    GoldenEntry* grown;
+    GoldenEntry* copy;
+    
+    if (set->count == set->capacity) {
+        set->capacity = set->capacity ? set->capacity * 2 : 64;
+        grown = realloc(set->entries, set->capacity * sizeof(GoldenEntry));
+        if (!grown) return -1;
+        set->entries = grown;
+    }
+    
+    copy = &set->entries[set->count];
+    *copy = *entry;
+    copy->rms = malloc((entry->num_windows + 1) * sizeof(u_short));
+    copy->window_hash = entry->window_hash ? malloc((entry->num_windows + 1) * sizeof(u_int)) : NULL;
+    if (!copy->rms || (entry->window_hash && !copy->window_hash)) {
+        free(copy->rms);
+        free(copy->window_hash);
+        return -1;
+    }
+    memcpy(copy->rms, entry->rms, entry->num_windows * sizeof(u_short));
+    if (entry->window_hash) {
+        memcpy(copy->window_hash, entry->window_hash, entry->num_windows * sizeof(u_int));
+    }
+    set->count++;
+    return 0;
+}
+
+// One line: song_hash bank_hash song bank frames pcm_hash windows rms... window_hash...
+// (version 1: no window hashes)
+int goldenLoad(GoldenSet* set, const char* path)
+{
+    FILE* f;
+    char* line = NULL;
+    char* p;
+    size_t size = 0;
+    GoldenEntry entry;
+    int w, used;
+    int version = GOLDEN_VERSION;
+    int result = 0;
+    
+    memset(set, 0, sizeof(GoldenSet));
+    renderDefaults(&set->options);
+    f = fopen(path, "r");
+    if (!f) return 0;
+    
+    while (getline(&line, &size, f) > 0) {
+        if (strncmp(line, GOLDEN_MAGIC, strlen(GOLDEN_MAGIC)) == 0) {
+            if (sscanf(line + strlen(GOLDEN_MAGIC), "%d loops=%d rate=%d tail=%d", &version,
+                       &set->options.loops, &set->options.tick_rate, &set->options.tail_ms) < 1 ||
+                version < 1 || version > GOLDEN_VERSION) {
+                result = -1;
+                break;
+            }
+            continue;
+        }
+        if (line[0] == '#' || line[0] == '\n') continue;
+        
+        memset(&entry, 0, sizeof(entry));
+        if (sscanf(line, "%llx %llx %127s %127s %u %llx %d%n", &entry.song_hash, &entry.bank_hash,
+                   entry.song, entry.bank, &entry.frames, &entry.pcm_hash, &entry.num_windows, &used) != 7 ||
+            entry.num_windows < 0) {
+            result = -1;
+            break;
+        }
+        
+        entry.rms = malloc((entry.num_windows + 1) * sizeof(u_short));
+        entry.window_hash = version >= 2 ? malloc((entry.num_windows + 1) * sizeof(u_int)) : NULL;
+        if (!entry.rms || (version >= 2 && !entry.window_hash)) {
+            free(entry.rms);
+            free(entry.window_hash);
+            result = -1;
+            break;
+        }
+        p = line + used;
+        for (w = 0; w < entry.num_windows; w++) {
+            entry.rms[w] = (u_short)strtoul(p, &p, 10);
+        }
+        for (w = 0; w < entry.num_windows && entry.window_hash; w++) {
+            entry.window_hash[w] = (u_int)strtoul(p, &p, 16);
+        }
+        result = goldenAdd(set, &entry);
+        free(entry.rms);
+        free(entry.window_hash);
+        if (result < 0) break;
+    }
+    
+    free(line);
+    fclose(f);
+    return result;
+}
+
+int goldenSave(const GoldenSet* set, const char* path)
+{
+    const GoldenEntry* e;
+    FILE* f = fopen(path, "w");
+    int i, w;
+    
+    if (!f) return -1;
+    
+    fprintf(f, GOLDEN_MAGIC "%d loops=%d rate=%d tail=%d\n", GOLDEN_VERSION, set->options.loops,
+            set->options.tick_rate, set->options.tail_ms);
+    fprintf(f, "# song_hash bank_hash song bank frames pcm_hash windows rms/%dms... window_hash...\n",
+            GOLDEN_WINDOW_MS);
+    for (i = 0; i < set->count; i++) {
+        e = &set->entries[i];
+        fprintf(f, "%016llx %016llx %s %s %u %016llx %d", e->song_hash, e->bank_hash,
+                e->song, e->bank, e->frames, e->pcm_hash, e->num_windows);
+        for (w = 0; w < e->num_windows; w++) {
+            fprintf(f, " %u", e->rms[w]);
+        }
+        for (w = 0; w < e->num_windows && e->window_hash; w++) {
+            fprintf(f, " %08x", e->window_hash[w]);
+        }
+        fputc('\n', f);
+    }
+    
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+const GoldenEntry* goldenFind(const GoldenSet* set, const GoldenEntry* entry, int* edited)
+{
+    const GoldenEntry* by_name = NULL;
+    const GoldenEntry* e;
+    int i;
+    
+    *edited = 0;
+    for (i = 0; i < set->count; i++) {
+        e = &set->entries[i];
+        if (e->song_hash == entry->song_hash && e->bank_hash == entry->bank_hash) {
+            return e;
+        }
+        if (!by_name && strcmp(e->song, entry->song) == 0 && strcmp(e->bank, entry->bank) == 0) {
+            by_name = e;
+        }
+    }
+    
+    *edited = by_name != NULL;
+    return by_name;
+}
+
+int goldenCompare(const GoldenEntry* golden, const GoldenEntry* entry, int tolerance, int* diff)
+{
+    int windows = golden->num_windows > entry->num_windows ? golden->num_windows : entry->num_windows;
+    int a, b, w;
+    
+    *diff = 0;
+    if (golden->pcm_hash == entry->pcm_hash && golden->frames == entry->frames) {
+        return -1;
+    }
+    
+    for (w = 0; w < windows; w++) {
+        a = w < golden->num_windows ? golden->rms[w] : 0;
+        b = w < entry->num_windows ? entry->rms[w] : 0;
+        *diff = a > b ? a - b : b - a;
+        if (*diff > tolerance) return w;
+    }
+    
+    *diff = 0;
+    return -1;
+}
+
+int goldenFirstChange(const GoldenEntry* golden, const GoldenEntry* entry)
+{
+    int windows = golden->num_windows < entry->num_windows ? golden->num_windows : entry->num_windows;
+    int w;
+    
+    if (golden->pcm_hash == entry->pcm_hash && golden->frames == entry->frames) {
+        return -1;
+    }
+    if (!golden->window_hash || !entry->window_hash) return 0;
+    
+    for (w = 0; w < windows; w++) {
+        if (golden->window_hash[w] != entry->window_hash[w]) return w;
+    }
+    return windows;
+}
+
+void goldenFree(GoldenSet* set)
+{
+    int i;
+    
+    for (i = 0; i < set->count; i++) {
+        free(set->entries[i].rms);
+        free(set->entries[i].window_hash);
+    }
+    free(set->entries);
+    memset(set, 0, sizeof(GoldenSet));
+}
@@ -0,0 +1,70 @@
+// Golden renders
+// A golden entry records what a song sounded like with a bank: the content
+// hashes of the inputs, a hash of the rendered PCM, and the RMS level and a
+// hash of the samples of every GOLDEN_WINDOW_MS window. A new render is
+// compared with the entry for the same inputs; identical PCM passes at once,
+// otherwise the first window whose level moved by more than a tolerance, or
+// else the first window whose samples changed, is reported (a pitch or timing
+// change can keep the loudness).
+
+#ifndef GOLDEN_H
+#define GOLDEN_H
+
+#include "render.h"
+
+#define GOLDEN_WINDOW_MS 100
+#define GOLDEN_WINDOW_FRAMES (44100 * GOLDEN_WINDOW_MS / 1000)
+#define GOLDEN_NAME_SIZE 128
+
+typedef unsigned long long GoldenHash;
+
+typedef struct {
+    GoldenHash song_hash;        // .seq content
+    GoldenHash bank_hash;        // .vh + .vb content
+    char song[GOLDEN_NAME_SIZE]; // File names, to find the entry again after an edit
+    char bank[GOLDEN_NAME_SIZE];
+    u_int frames;
+    GoldenHash pcm_hash;
+    int num_windows;
+    u_short* rms;                // Per window, 0-32767
+    u_int* window_hash;          // Per window, of the samples. NULL in version 1 files
+} GoldenEntry;
+
+typedef struct {
+    RenderOptions options;       // Options the goldens were rendered with
+    GoldenEntry* entries;
+    int count;
+    int capacity;
+} GoldenSet;
+
+// 64-bit FNV-1a, continue from a previous hash (start with GOLDEN_HASH_INIT)
+#define GOLDEN_HASH_INIT 0xCBF29CE484222325ULL
+GoldenHash goldenHash(const void* data, u_int size, GoldenHash hash);
+
+// Fill frames, pcm_hash, rms and window_hash of entry from a stereo render.
+// Returns -1 if out of memory
+int goldenMeasure(GoldenEntry* entry, const short* pcm, u_int frames);
+
+// Load a golden file (a missing file is an empty set with default options).
+// Version 1 files load without window hashes. Returns -1 on a bad file
+int goldenLoad(GoldenSet* set, const char* path);
+int goldenSave(const GoldenSet* set, const char* path);
+
+// Add a copy of entry
+int goldenAdd(GoldenSet* set, const GoldenEntry* entry);
+
+// Entry with the same input hashes, else with the same file names (inputs
+// edited since the golden was made, *edited is set), else NULL
+const GoldenEntry* goldenFind(const GoldenSet* set, const GoldenEntry* entry, int* edited);
+
+// First window whose level differs by more than tolerance (or that only
+// one of the renders has), -1 if all match. *diff is that window's difference
+int goldenCompare(const GoldenEntry* golden, const GoldenEntry* entry, int tolerance, int* diff);
+
+// First window whose samples differ (or that only one of the renders has),
+// -1 if the renders are identical. 0 if either has no window hashes
+int goldenFirstChange(const GoldenEntry* golden, const GoldenEntry* entry);
+
+void goldenFree(GoldenSet* set);
+
+#endif // GOLDEN_H
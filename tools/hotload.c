@@ -0,0 +1,271 @@
+// hotload - sends SEQ, VH and VB files to the player's receive mode over serial
+//
+// Usage: hotload [-b baud] port file...
+//
+// port is a serial device (/dev/ttyUSB0) or host:port for an emulator's
+// serial port over TCP (e.g. PCSX-Redux's SIO1 server). Put the player in
+// receive mode first (Triangle on the SEQ list). A .vh is sent with the .vb
+// of the same name (SOUNDBANK/VH -> SOUNDBANK/VB) unless that is also given.
+// Files replace received files of the same name, a complete bank is uploaded
+// to SPU RAM straight away. Protocol in ../hotload.h.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include "vab.h"
+#include "../pak.h"
+#include "../hotload.h"
+
+#define PATH_SIZE 1024
+#define REPLY_MS 1000            // Longer than the player's packet timeout (15 frames)
+#define TRIES 8
+
+// Checks the layout the player reads (a little-endian host is assumed)
+typedef char hot_header_size_check[sizeof(HotHeader) == 52 ? 1 : -1];
+
+static const char* fileName(const char* path)
+{
+    const char* slash = strrchr(path, '/');
+    
+    return slash ? slash + 1 : path;
+}
+
+static int fileType(const char* path)
+{
+    const char* dot = strrchr(path, '.');
+    
+    if (!dot) return -1;
+    if (strcasecmp(dot, ".seq") == 0) return PAK_SEQ;
+    if (strcasecmp(dot, ".vh") == 0) return PAK_VH;
+    if (strcasecmp(dot, ".vb") == 0) return PAK_VB;
+    return -1;
+}
+
+// SOUNDBANK/VH/name.vh -> SOUNDBANK/VB/name.vb
+static void vbPathFor(char* out, const char* vh_path)
+{
+    char* dot;
+    char* dir;
+    
+    snprintf(out, PATH_SIZE, "%s", vh_path);
+    dot = strrchr(out, '.');
+    if (dot && !strchr(dot, '/')) *dot = 0;
+    strncat(out, ".vb", PATH_SIZE - strlen(out) - 1);
+    dir = strstr(out, "VH/");
+    while (dir) {
+        char* next = strstr(dir + 1, "VH/");
+        if (!next) break;
+        dir = next;
+    }
+    if (dir) dir[1] = 'B';
+}
+
+static speed_t baudConstant(int baud)
+{
+    switch (baud) {
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+    }
+    return 0;
+}
+
+// Serial device in raw 8N1, or a TCP connection for host:port
+static int openPort(const char* port, int baud)
+{
+    struct termios tio;
+    struct addrinfo hints, *addr;
+    char host[256];
+    const char* colon = strrchr(port, ':');
+    int fd;
+    
+    if (colon && !strchr(port, '/')) {
+        snprintf(host, sizeof(host), "%.*s", (int)(colon - port), port);
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(host, colon + 1, &hints, &addr) != 0) return -1;
+        fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+        if (fd >= 0 && connect(fd, addr->ai_addr, addr->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+        freeaddrinfo(addr);
+        return fd;
+    }
+    
+    fd = open(port, O_RDWR | O_NOCTTY);
+    if (fd < 0) return -1;
+    if (tcgetattr(fd, &tio) != 0 || !baudConstant(baud)) {
+        close(fd);
+        return -1;
+    }
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, baudConstant(baud));
+    cfsetospeed(&tio, baudConstant(baud));
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+    if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+        close(fd);
+        return -1;
+    }
+    tcflush(fd, TCIOFLUSH);
+    return fd;
+}
+
+static int writeAll(int fd, const u_char* data, u_int size)
+{
+    ssize_t n;
+    
+    while (size > 0) {
+        n = write(fd, data, size);
+        if (n <= 0) return -1;
+        data += n;
+        size -= n;
+    }
+    return 0;
+}
+
+// Reply byte, -1 after REPLY_MS without one
+static int readReply(int fd)
+{
+    struct pollfd p = {fd, POLLIN, 0};
+    u_char c;
+    
+    if (poll(&p, 1, REPLY_MS) <= 0 || read(fd, &c, 1) != 1) return -1;
+    return c;
+}
+
+// Send a packet until it gets a reply other than HOT_NAK (or none)
+static int sendPacket(int fd, const u_char* packet, u_int size)
+{
+    int reply = -1;
+    int i;
+    
+    for (i = 0; i < TRIES; i++) {
+        if (writeAll(fd, packet, size) < 0) return -1;
+        reply = readReply(fd);
+        if (reply != HOT_NAK && reply != -1) return reply;
+    }
+    return reply;
+}
+
+static void put32(u_char* p, u_int v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static int sendFile(int fd, const char* path)
+{
+    HotHeader header;
+    u_char packet[HOT_CHUNK_HEAD + HOT_CHUNK + HOT_CHUNK_TAIL];
+    const char* name = fileName(path);
+    u_char* data;
+    u_int size, pos, length, index;
+    int reply;
+    
+    if (strlen(name) >= PAK_NAME_SIZE) {
+        fprintf(stderr, "%s: name longer than %d characters\n", path, PAK_NAME_SIZE - 1);
+        return -1;
+    }
+    data = loadFile(path, &size);
+    if (!data || size == 0) {
+        fprintf(stderr, "%s: cannot read\n", path);
+        return -1;
+    }
+    
+    memset(&header, 0, sizeof(header));
+    header.magic = HOT_MAGIC;
+    header.size = size;
+    header.hash = pakHash(data, size, PAK_HASH_INIT);
+    header.type = fileType(path);
+    strncpy(header.name, name, PAK_NAME_SIZE - 1);
+    header.check = pakHash((u_char*)&header, sizeof(header) - 4, PAK_HASH_INIT);
+    
+    reply = sendPacket(fd, (u_char*)&header, sizeof(header));
+    if (reply != HOT_ACK) {
+        fprintf(stderr, "%s: %s\n", name, reply == HOT_REFUSE ? "refused, no room in the player" :
+                                          "no answer (is the player in receive mode?)");
+        free(data);
+        return -1;
+    }
+    
+    for (pos = 0, index = 0; pos < size; pos += length, index++) {
+        length = size - pos < HOT_CHUNK ? size - pos : HOT_CHUNK;
+        packet[0] = index;
+        packet[1] = index >> 8;
+        packet[2] = length;
+        packet[3] = length >> 8;
+        memcpy(packet + HOT_CHUNK_HEAD, data + pos, length);
+        put32(packet + HOT_CHUNK_HEAD + length, pakHash(packet, HOT_CHUNK_HEAD + length, PAK_HASH_INIT));
+    
+        reply = sendPacket(fd, packet, HOT_CHUNK_HEAD + length + HOT_CHUNK_TAIL);
+        if (pos + length < size ? reply != HOT_ACK : reply != HOT_DONE) {
+            fprintf(stderr, "\n%s: %s at byte %u\n", name, reply == HOT_REFUSE ? "damaged" : "no answer", pos);
+            free(data);
+            return -1;
+        }
+        printf("\r%s: %uK of %uK", name, (pos + length) >> 10, size >> 10);
+        fflush(stdout);
+    }
+    printf("\n");
+    free(data);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    char vb_path[PATH_SIZE];
+    int baud = HOT_BAUD;
+    int fd, i, j, sent_vb;
+    
+    if (argc > 2 && strcmp(argv[1], "-b") == 0) {
+        baud = atoi(argv[2]);
+        argv += 2;
+        argc -= 2;
+    }
+    if (argc < 3) {
+        fprintf(stderr, "usage: hotload [-b baud] port file...\n");
+        return 1;
+    }
+    for (i = 2; i < argc; i++) {
+        if (fileType(argv[i]) < 0) {
+            fprintf(stderr, "%s: not a .seq, .vh or .vb file\n", argv[i]);
+            return 1;
+        }
+    }
+    
+    fd = openPort(argv[1], baud);
+    if (fd < 0) {
+        fprintf(stderr, "%s: cannot open (baud %d)\n", argv[1], baud);
+        return 1;
+    }
+    
+    for (i = 2; i < argc; i++) {
+        if (sendFile(fd, argv[i]) < 0) return 1;
+        if (fileType(argv[i]) != PAK_VH) continue;
+    
+        // The VB of a VH, unless it is on the command line too
+        vbPathFor(vb_path, argv[i]);
+        sent_vb = 0;
+        for (j = 2; j < argc; j++) {
+            if (fileType(argv[j]) == PAK_VB && strcmp(fileName(argv[j]), fileName(vb_path)) == 0) sent_vb = 1;
+        }
+        if (!sent_vb && sendFile(fd, vb_path) < 0) return 1;
+    }
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,97 @@
+// LZ block compression (see lzpack.h)
+// Greedy parse with a hash chain per 4-byte prefix. Assets are compressed once
+// at build time, so it searches harder than LZ4's fast mode does
+
+#include <string.h>
+#include <sys/types.h>
+#include "../lz.h"
+#include "lzpack.h"
+
+#define HASH_BITS 14
+#define WINDOW 65535             // 16-bit offsets
+#define MAX_CHAIN 256            // Candidates tried per position
+
+static u_int hash4(const u_char* p)
+{
+    u_int v = p[0] | (p[1] << 8) | (p[2] << 16) | ((u_int)p[3] << 24);
+    
+    return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Length with the 15 + 255-run extension
+static u_char* putLength(u_char* out, u_int length)
+{
+    while (length >= 255) {
+        *out++ = 255;
+        length -= 255;
+    }
+    *out++ = (u_char)length;
+    return out;
+}
+
+static u_char* putSequence(u_char* out, const u_char* literals, u_int num_literals, u_int offset, u_int match)
+{
+    u_char* token = out++;
+    u_int m = match ? match - LZ_MIN_MATCH : 0;
+    
+    *token = (u_char)(((num_literals < 15 ? num_literals : 15) << 4) | (m < 15 ? m : 15));
+    if (num_literals >= 15) out = putLength(out, num_literals - 15);
+    memcpy(out, literals, num_literals);
+    out += num_literals;
+    
+    if (match) {
+        *out++ = (u_char)offset;
+        *out++ = (u_char)(offset >> 8);
+        if (m >= 15) out = putLength(out, m - 15);
+    }
+    return out;
+}
+
+u_int lzCompress(const u_char* src, u_int src_size, u_char* dst)
+{
+    static int head[1 << HASH_BITS];
+    static int chain[WINDOW + 1];
+    const u_char* anchor = src;
+    u_char* out = dst;
+    u_int pos = 0, best, best_offset, length, h, tries;
+    int candidate;
+    
+    memset(head, -1, sizeof(head));
+    
+    while (pos + LZ_MIN_MATCH <= src_size) {
+        h = hash4(src + pos);
+        best = 0;
+        best_offset = 0;
+        tries = 0;
+        for (candidate = head[h]; candidate >= 0 && pos - candidate <= WINDOW && tries < MAX_CHAIN;
+             candidate = chain[candidate & WINDOW], tries++) {
+            for (length = 0; pos + length < src_size && src[candidate + length] == src[pos + length]; length++);
+            if (length > best) {
+                best = length;
+                best_offset = pos - candidate;
+            }
+        }
+        chain[pos & WINDOW] = head[h];
+        head[h] = pos;
+        
+        if (best < LZ_MIN_MATCH) {
+            pos++;
+            continue;
+        }
+        
+        out = putSequence(out, anchor, (u_int)(src + pos - anchor), best_offset, best);
+        
+        // Positions inside the match can still start later matches
+        for (length = 1; length < best && pos + length + LZ_MIN_MATCH <= src_size; length++) {
+            h = hash4(src + pos + length);
+            chain[(pos + length) & WINDOW] = head[h];
+            head[h] = pos + length;
+        }
+        pos += best;
+        anchor = src + pos;
+    }
+    
+    // Trailing literals end the block
+    out = putSequence(out, anchor, (u_int)(src + src_size - anchor), 0, 0);
+    return (u_int)(out - dst);
+}
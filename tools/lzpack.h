@@ -0,0 +1,13 @@
+// LZ block compression for the asset archive (the player only decompresses,
+// see ../lz.h for the format)
+
+#ifndef LZPACK_H
+#define LZPACK_H
+
+// Worst case output size for size input bytes
+#define LZ_BOUND(size) ((size) + (size) / 255 + 16)
+
+// Compress src into dst (LZ_BOUND(src_size) bytes). Returns the compressed size
+u_int lzCompress(const u_char* src, u_int src_size, u_char* dst);
+
+#endif // LZPACK_H
@@ -0,0 +1,220 @@
+// pack - builds the player's asset archive (see ../pak.h)
+//
+// Usage: pack [-z] [-s] assets.pak [-p pool.vb] file...
+//
+// The entry type comes from the file extension (.seq .vh .vb .tim), -p marks
+// the VB_POOL sample pool. Files keep the order given, so the player lists
+// them in that order. Each VH needs a VB with the same name.
+//
+// -z stores SEQ, VB and pool entries as LZ blocks when that is smaller. VHs
+// stay as they are since libsnd reads an open VH in place, and the TIM is
+// only read once.
+//
+// -s aligns every file on a CD sector for a disc archive, whose files the player
+// reads with CdRead instead of linking them. Not combined with -z.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/types.h>
+#include "vab.h"
+#include "lzpack.h"
+#include "../lz.h"
+#include "../pak.h"
+
+#define LE16(p) ((p)[0] | ((p)[1] << 8))
+#define ALIGN(x) (((x) + align - 1) & ~(align - 1))
+
+// Checks the layout the player reads in place (a little-endian host is assumed)
+typedef char pak_entry_size_check[sizeof(PakEntry) == 56 ? 1 : -1];
+
+static int entryType(const char* path)
+{
+    const char* dot = strrchr(path, '.');
+    
+    if (!dot) return -1;
+    if (strcasecmp(dot, ".seq") == 0) return PAK_SEQ;
+    if (strcasecmp(dot, ".vh") == 0) return PAK_VH;
+    if (strcasecmp(dot, ".vb") == 0) return PAK_VB;
+    if (strcasecmp(dot, ".tim") == 0) return PAK_TIM;
+    return -1;
+}
+
+// Replace data with LZ blocks if that is smaller. Every block is expanded
+// again and compared, so a compressor bug fails the build instead of the player
+static int compressEntry(PakEntry* entry, u_char** data)
+{
+    u_char* packed = malloc(entry->size / PAK_BLOCK * 2 + LZ_BOUND(entry->size) + 2);
+    u_char block[PAK_BLOCK];
+    const u_char* cursor;
+    u_char* out;
+    u_int pos, chunk, length, stored = 0;
+    
+    if (!packed) return -1;
+    for (pos = 0; pos < entry->size; pos += chunk) {
+        chunk = entry->size - pos < PAK_BLOCK ? entry->size - pos : PAK_BLOCK;
+        out = packed + stored;
+        length = lzCompress(*data + pos, chunk, out + 2);
+        if (length >= chunk) {
+            memcpy(out + 2, *data + pos, chunk);
+            length = chunk | PAK_BLOCK_RAW;
+        }
+        out[0] = (u_char)length;
+        out[1] = (u_char)(length >> 8);
+        stored += 2 + (length & ~PAK_BLOCK_RAW);
+        
+        cursor = out;
+        if (pakUnpackBlock(&cursor, block) != (int)chunk || memcmp(block, *data + pos, chunk) != 0) {
+            fprintf(stderr, "%s: block %u does not decompress\n", entry->name, pos / PAK_BLOCK);
+            return -1;
+        }
+    }
+    
+    if (stored < entry->size) {
+        free(*data);
+        *data = packed;
+        entry->packed = stored;
+        entry->flags |= PAK_FLAG_LZ;
+    } else {
+        free(packed);
+    }
+    return 0;
+}
+
+// Same name with another extension
+static void replaceExtension(char* out, int size, const char* name, const char* ext)
+{
+    const char* dot = strrchr(name, '.');
+    int length = dot ? (int)(dot - name) : (int)strlen(name);
+    
+    snprintf(out, size, "%.*s%s", length, name, ext);
+}
+
+int main(int argc, char** argv)
+{
+    PakHeader header;
+    PakEntry* index;
+    u_char** data;
+    static const u_char zero[PAK_SECTOR];
+    const char* slash;
+    char vb_name[PAK_NAME_SIZE + 4];
+    u_int offset, total = 0;
+    FILE* f;
+    u_int align = PAK_ALIGN;
+    int count = 0, pool = 0, compress = 0, samples = 0;
+    int i, j;
+    
+    while (argc > 1 && argv[1][0] == '-') {
+        if (strcmp(argv[1], "-z") == 0) {
+            compress = 1;
+        } else if (strcmp(argv[1], "-s") == 0) {
+            align = PAK_SECTOR;
+        } else {
+            break;
+        }
+        argv++;
+        argc--;
+    }
+    if (argc < 3 || (compress && align == PAK_SECTOR)) {
+        fprintf(stderr, "usage: pack [-z] [-s] assets.pak [-p pool.vb] file...\n");
+        return 1;
+    }
+    index = calloc(argc, sizeof(PakEntry));
+    data = calloc(argc, sizeof(u_char*));
+    if (!index || !data) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    
+    for (i = 2; i < argc; i++) {
+        PakEntry* entry = &index[count];
+        
+        if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            pool = 1;
+            continue;
+        }
+        
+        entry->type = pool ? PAK_POOL : entryType(argv[i]);
+        pool = 0;
+        slash = strrchr(argv[i], '/');
+        if (entry->type == (u_char)-1) {
+            fprintf(stderr, "%s: unknown file type\n", argv[i]);
+            return 1;
+        }
+        if (strlen(slash ? slash + 1 : argv[i]) >= PAK_NAME_SIZE) {
+            fprintf(stderr, "%s: name longer than %d characters\n", argv[i], PAK_NAME_SIZE - 1);
+            return 1;
+        }
+        strncpy(entry->name, slash ? slash + 1 : argv[i], PAK_NAME_SIZE);
+        
+        data[count] = loadFile(argv[i], &entry->size);
+        if (!data[count]) {
+            fprintf(stderr, "%s: cannot read\n", argv[i]);
+            return 1;
+        }
+        entry->packed = entry->size;
+        total += entry->size;
+        
+        if (entry->type == PAK_VH) {
+            if (entry->size < 32 || memcmp(data[count], "pBAV", 4) != 0) {
+                fprintf(stderr, "%s: not a valid VH\n", argv[i]);
+                return 1;
+            }
+            entry->programs = LE16(data[count] + 18);
+            entry->tones = LE16(data[count] + 20);
+        }
+        if (compress && (entry->type == PAK_SEQ || entry->type == PAK_VB || entry->type == PAK_POOL) &&
+            compressEntry(entry, &data[count]) < 0) {
+            return 1;
+        }
+        entry->hash = pakHash(data[count], entry->packed, PAK_HASH_INIT);
+        count++;
+    }
+    
+    // The player plays a VH with the VB of the same name, unless its samples are
+    // in the pool. An archive with no samples at all has them on the disc
+    for (i = 0; i < count; i++) {
+        if (index[i].type == PAK_POOL) pool = 1;
+        if (index[i].type == PAK_VB) samples = 1;
+    }
+    for (i = 0; i < count && samples && !pool; i++) {
+        if (index[i].type != PAK_VH) continue;
+        replaceExtension(vb_name, sizeof(vb_name), index[i].name, ".vb");
+        for (j = 0; j < count; j++) {
+            if (index[j].type == PAK_VB && strcmp(index[j].name, vb_name) == 0) break;
+        }
+        if (j == count) {
+            fprintf(stderr, "%s: no %s\n", index[i].name, vb_name);
+            return 1;
+        }
+    }
+    
+    offset = ALIGN(sizeof(PakHeader) + count * sizeof(PakEntry));
+    for (i = 0; i < count; i++) {
+        index[i].offset = offset;
+        offset = ALIGN(offset + index[i].packed);
+    }
+    header.magic = PAK_MAGIC;
+    header.version = PAK_VERSION;
+    header.count = count;
+    header.size = offset;
+    
+    f = fopen(argv[1], "wb");
+    if (!f) {
+        fprintf(stderr, "%s: cannot write\n", argv[1]);
+        return 1;
+    }
+    fwrite(&header, sizeof(header), 1, f);
+    fwrite(index, sizeof(PakEntry), count, f);
+    fwrite(zero, 1, ALIGN(sizeof(PakHeader) + count * sizeof(PakEntry)) - (sizeof(PakHeader) + count * sizeof(PakEntry)), f);
+    for (i = 0; i < count; i++) {
+        fwrite(data[i], 1, index[i].packed, f);
+        fwrite(zero, 1, ALIGN(index[i].packed) - index[i].packed, f);
+        free(data[i]);
+    }
+    fclose(f);
+    
+    printf("pack: %d files, %u bytes (%u bytes of files)\n", count, header.size, total);
+    return 0;
+}
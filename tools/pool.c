@@ -0,0 +1,123 @@
+// Work-stealing thread pool (see pool.h)
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "pool.h"
+
+typedef struct {
+    pthread_mutex_t lock;
+    int* jobs;
+    int head;                // Thieves take from here
+    int tail;                // The owner takes from here
+} PoolDeque;
+
+typedef struct {
+    PoolDeque* deques;
+    int threads;
+    PoolJob run;
+    void* context;
+} Pool;
+
+typedef struct {
+    Pool* pool;
+    int id;
+} PoolWorker;
+
+int poolCpuCount(void)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    
+    return cpus > 0 ? (int)cpus : 1;
+}
+
+// Next job for thread id, -1 when every deque is empty. No jobs are added
+// after the start, so empty deques stay empty
+static int poolTake(Pool* pool, int id)
+{
+    PoolDeque* d;
+    int job = -1;
+    int i;
+    
+    for (i = 0; i < pool->threads && job < 0; i++) {
+        d = &pool->deques[(id + i) % pool->threads];
+        pthread_mutex_lock(&d->lock);
+        if (d->tail > d->head) {
+            job = (i == 0) ? d->jobs[--d->tail] : d->jobs[d->head++];
+        }
+        pthread_mutex_unlock(&d->lock);
+    }
+    
+    return job;
+}
+
+static void* poolWorker(void* arg)
+{
+    PoolWorker* worker = arg;
+    int job;
+    
+    while ((job = poolTake(worker->pool, worker->id)) >= 0) {
+        worker->pool->run(job, worker->id, worker->pool->context);
+    }
+    return NULL;
+}
+
+int poolRun(int threads, int count, PoolJob run, void* context)
+{
+    Pool pool;
+    PoolWorker* workers;
+    pthread_t* handles;
+    int* jobs;
+    int started = 0;
+    int i, first, last;
+    
+    if (threads <= 0) threads = poolCpuCount();
+    if (threads > count) threads = count > 0 ? count : 1;
+    
+    pool.deques = calloc(threads, sizeof(PoolDeque));
+    workers = calloc(threads, sizeof(PoolWorker));
+    handles = calloc(threads, sizeof(pthread_t));
+    jobs = malloc((count > 0 ? count : 1) * sizeof(int));
+    if (!pool.deques || !workers || !handles || !jobs) {
+        free(pool.deques);
+        free(workers);
+        free(handles);
+        free(jobs);
+        return -1;
+    }
+    pool.threads = threads;
+    pool.run = run;
+    pool.context = context;
+    
+    // Contiguous ranges, so each thread starts on its own part of the matrix
+    for (i = 0; i < count; i++) jobs[i] = i;
+    for (i = 0; i < threads; i++) {
+        first = (int)((long long)count * i / threads);
+        last = (int)((long long)count * (i + 1) / threads);
+        pthread_mutex_init(&pool.deques[i].lock, NULL);
+        pool.deques[i].jobs = jobs + first;
+        pool.deques[i].head = 0;
+        pool.deques[i].tail = last - first;
+        workers[i].pool = &pool;
+        workers[i].id = i;
+    }
+    
+    // The calling thread is worker 0
+    for (i = 1; i < threads; i++) {
+        if (pthread_create(&handles[i], NULL, poolWorker, &workers[i]) != 0) break;
+        started++;
+    }
+    poolWorker(&workers[0]);
+    for (i = 1; i <= started; i++) {
+        pthread_join(handles[i], NULL);
+    }
+    
+    for (i = 0; i < threads; i++) {
+        pthread_mutex_destroy(&pool.deques[i].lock);
+    }
+    free(pool.deques);
+    free(workers);
+    free(handles);
+    free(jobs);
+    return 0;
+}
@@ -0,0 +1,19 @@
+// Work-stealing thread pool for the host tools
+// Jobs are numbered 0..count-1 and dealt out in contiguous ranges, one deque
+// per thread. A thread works through its own deque from the back and, once it
+// is empty, steals from the front of the others, so long jobs on one thread
+// do not leave the rest idle.
+
+#ifndef POOL_H
+#define POOL_H
+
+typedef void (*PoolJob)(int job, int thread, void* context);
+
+// Run count jobs on threads threads (<= 0: one per online CPU) and wait for
+// all of them. Returns 0, or -1 if the threads could not be started
+int poolRun(int threads, int count, PoolJob run, void* context);
+
+// Online CPUs
+int poolCpuCount(void);
+
+#endif // POOL_H
@@ -0,0 +1,312 @@
+// Host sequence renderer (see render.h)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include "render.h"
+#include "spu.h"
+
+#define RENDER_CHUNK 256          // Frames mixed at a time for the release tail
+
+// Render state of one song
+typedef struct {
+    const SeqSong* song;
+    const VabBank* bank;
+    Spu spu;
+    SeqChannelState chan;
+    u_int tempo;
+    RenderResult* result;
+} Renderer;
+
+void renderDefaults(RenderOptions* options)
+{
+    options->loops = 0;
+    options->tick_rate = 240;     // SEQ_TICK_RATE of the player
+    options->tail_ms = 5000;
+}
+
+static int renderMix(Renderer* r, u_int frames)
+{
+    RenderResult* result = r->result;
+    short* pcm;
+    u_int capacity;
+    
+    if (result->frames + frames > result->capacity) {
+        capacity = result->capacity ? result->capacity : SPU_RATE * 8;
+        while (capacity < result->frames + frames) capacity *= 2;
+        pcm = realloc(result->pcm, (size_t)capacity * 2 * sizeof(short));
+        if (!pcm) return -1;
+        result->pcm = pcm;
+        result->capacity = capacity;
+    }
+    
+    spuMix(&r->spu, result->pcm + result->frames * 2, frames);
+    result->frames += frames;
+    return 0;
+}
+
+// Same law as the player's seqVoiceVolume (0-127 per side)
+static void renderPan(int vol, int pan, int* left, int* right)
+{
+    *left = (pan <= 64) ? vol : (vol * (127 - pan)) / 63;
+    *right = (pan >= 64) ? vol : (vol * pan) / 64;
+}
+
+// Voice registers for a note: channel level scaled by the tone, program and
+// bank volumes, panned by the channel then by the tone and program pans
+static void renderVoiceVolume(Renderer* r, const VabProgram* prog, const VabTone* tone,
+                              int channel, int velocity, int* vol_l, int* vol_r)
+{
+    int vol = (velocity * r->chan.volume[channel]) / 127;
+    int pan = tone->pan + prog->mpan - 64;
+    int l, r2, tl, tr;
+    
+    if (pan < 0) pan = 0;
+    if (pan > 127) pan = 127;
+    
+    vol = vol * tone->vol / 127 * prog->mvol / 127 * r->bank->mvol / 127;
+    renderPan(vol, r->chan.pan[channel], &l, &r2);
+    renderPan(127, pan, &tl, &tr);
+    
+    *vol_l = l * tl / 127 * SPU_VOLUME_MAX / 127;
+    *vol_r = r2 * tr / 127 * SPU_VOLUME_MAX / 127;
+}
+
+static void renderNoteOn(Renderer* r, int channel, int note, int velocity)
+{
+    const VabProgram* prog = &r->bank->program[r->chan.program[channel]];
+    const VabTone* tone;
+    SpuVoice* v;
+    int vol_l, vol_r;
+    int t, voice;
+    
+    // Every tone whose range covers the note plays (layered tones)
+    for (t = 0; t < prog->tones; t++) {
+        tone = &prog->tone[t];
+        if (note < tone->min || note > tone->max) continue;
+        if (tone->vag <= 0 || tone->vag > r->bank->num_vags) continue;
+        
+        voice = spuAlloc(&r->spu, tone->prior);
+        if (voice < 0) continue;
+        
+        renderVoiceVolume(r, prog, tone, channel, velocity, &vol_l, &vol_r);
+        spuKeyOn(&r->spu, voice, &r->bank->sample[tone->vag],
+                 spuNotePitch(tone, note, r->chan.bend[channel]),
+                 vol_l, vol_r, tone->adsr1, tone->adsr2);
+        
+        v = &r->spu.voice[voice];
+        v->channel = channel;
+        v->note = note;
+        v->tone = tone;
+    }
+}
+
+static void renderNoteOff(Renderer* r, int channel, int note)
+{
+    int v;
+    
+    for (v = 0; v < SPU_VOICES; v++) {
+        if (r->spu.voice[v].channel == channel && r->spu.voice[v].note == note) {
+            spuKeyOff(&r->spu, v);
+        }
+    }
+}
+
+static void renderAllNotesOff(Renderer* r)
+{
+    int v;
+    
+    for (v = 0; v < SPU_VOICES; v++) {
+        if (r->spu.voice[v].channel >= 0) {
+            spuKeyOff(&r->spu, v);
+        }
+    }
+}
+
+static void renderDispatch(Renderer* r, const SeqEvent* ev)
+{
+    const VabProgram* prog;
+    SpuVoice* v;
+    int i, l, rr;
+    
+    switch (ev->type) {
+        case SEQ_EV_NOTE_ON:
+            renderNoteOn(r, ev->channel, ev->data1, ev->data2);
+            break;
+        case SEQ_EV_NOTE_OFF:
+            renderNoteOff(r, ev->channel, ev->data1);
+            break;
+        case SEQ_EV_CONTROL:
+            if (ev->data1 != SEQ_CC_VOLUME && ev->data1 != SEQ_CC_PAN) break;
+            seqApplyEvent(&r->chan, &r->tempo, ev);
+            
+            // Apply to notes already sounding on this channel
+            prog = &r->bank->program[r->chan.program[ev->channel]];
+            for (i = 0; i < SPU_VOICES; i++) {
+                v = &r->spu.voice[i];
+                if (v->channel != ev->channel) continue;
+                renderVoiceVolume(r, prog, v->tone, ev->channel, 127, &l, &rr);
+                v->vol_l = l;
+                v->vol_r = rr;
+            }
+            break;
+        case SEQ_EV_PITCH_BEND:
+            seqApplyEvent(&r->chan, &r->tempo, ev);
+            for (i = 0; i < SPU_VOICES; i++) {
+                v = &r->spu.voice[i];
+                if (v->channel != ev->channel) continue;
+                v->pitch = spuNotePitch(v->tone, v->note, ev->data1);
+                if (v->pitch > 0x3FFF) v->pitch = 0x3FFF;
+            }
+            break;
+        default:
+            seqApplyEvent(&r->chan, &r->tempo, ev);
+            break;
+    }
+}
+
+// Output frame of a song time (usec * resolution)
+static u_int renderFrameAt(const Renderer* r, const RenderOptions* options, unsigned long long time)
+{
+    unsigned long long unit = (unsigned long long)r->song->resolution * 1000000;
+    unsigned long long tick;
+    
+    if (options->tick_rate <= 0) {
+        return (u_int)(time * SPU_RATE / unit);
+    }
+    
+    // The player handles an event on the first tick interrupt at or after it
+    tick = (time * options->tick_rate + unit - 1) / unit;
+    return (u_int)(tick * SPU_RATE / options->tick_rate);
+}
+
+int renderSong(const SeqSong* song, const VabBank* bank, const RenderOptions* options, RenderResult* result)
+{
+    Renderer* r;
+    SeqTempoEntry* map;
+    const SeqEvent* ev;
+    unsigned long long offset = 0;
+    u_int frame, tail;
+    int count, cursor = 0;
+    int loops = options->loops;
+    int status = 0;
+    
+    memset(result, 0, sizeof(RenderResult));
+    
+    r = malloc(sizeof(Renderer));
+    map = malloc((song->num_events + 1) * sizeof(SeqTempoEntry));
+    if (!r || !map) {
+        free(r);
+        free(map);
+        return -1;
+    }
+    
+    r->song = song;
+    r->bank = bank;
+    r->tempo = song->tempo;
+    r->result = result;
+    spuInit(&r->spu);
+    seqResetChannels(&r->chan);
+    count = seqBuildTempoMap(song, map, song->num_events + 1);
+    
+    while (status == 0) {
+        // Loop end (or end of track when there is no marker)
+        if (cursor >= song->loop_end) {
+            if (loops <= 0 || song->loop_start_tick >= song->loop_end_tick) {
+                break;
+            }
+            loops--;
+            renderAllNotesOff(r);
+            offset += seqTickToTime(map, count, song->loop_end_tick) -
+                      seqTickToTime(map, count, song->loop_start_tick);
+            cursor = song->loop_start;
+            continue;
+        }
+        
+        ev = &song->events[cursor++];
+        frame = renderFrameAt(r, options, offset + seqTickToTime(map, count, ev->tick));
+        if (frame > result->frames) {
+            status = renderMix(r, frame - result->frames);
+        }
+        renderDispatch(r, ev);
+    }
+    
+    // Let released notes ring out
+    renderAllNotesOff(r);
+    tail = (u_int)options->tail_ms * (SPU_RATE / 1000);
+    while (status == 0 && tail > 0) {
+        status = renderMix(r, RENDER_CHUNK);
+        tail = tail > RENDER_CHUNK ? tail - RENDER_CHUNK : 0;
+        
+        for (count = 0; count < SPU_VOICES; count++) {
+            if (r->spu.voice[count].env.phase != ENV_OFF) break;
+        }
+        if (count == SPU_VOICES) break;
+    }
+    
+    result->peak = r->spu.peak;
+    result->steals = r->spu.steals;
+    result->refused = r->spu.refused;
+    
+    free(map);
+    free(r);
+    return status;
+}
+
+void renderFree(RenderResult* result)
+{
+    free(result->pcm);
+    result->pcm = NULL;
+}
+
+static void putLE(u_char* p, u_int value, int bytes)
+{
+    int i;
+    
+    for (i = 0; i < bytes; i++) {
+        p[i] = (u_char)(value >> (i * 8));
+    }
+}
+
+int writeWav(const char* path, const short* pcm, u_int frames)
+{
+    u_char header[44];
+    u_char* data;
+    u_int size = frames * 4;
+    u_int i;
+    FILE* f;
+    int ok;
+    
+    memcpy(header, "RIFF", 4);
+    putLE(header + 4, 36 + size, 4);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    putLE(header + 16, 16, 4);
+    putLE(header + 20, 1, 2);              // PCM
+    putLE(header + 22, 2, 2);              // Stereo
+    putLE(header + 24, SPU_RATE, 4);
+    putLE(header + 28, SPU_RATE * 4, 4);
+    putLE(header + 32, 4, 2);
+    putLE(header + 34, 16, 2);
+    memcpy(header + 36, "data", 4);
+    putLE(header + 40, size, 4);
+    
+    // Samples are little-endian whatever the host is
+    data = malloc(size ? size : 1);
+    if (!data) return -1;
+    for (i = 0; i < frames * 2; i++) {
+        putLE(data + i * 2, (u_short)pcm[i], 2);
+    }
+    
+    f = fopen(path, "wb");
+    if (!f) {
+        free(data);
+        return -1;
+    }
+    ok = fwrite(header, 1, sizeof(header), f) == sizeof(header) &&
+         fwrite(data, 1, size, f) == size;
+    ok = (fclose(f) == 0) && ok;
+    free(data);
+    
+    return ok ? 0 : -1;
+}
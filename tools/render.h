@@ -0,0 +1,40 @@
+// Host sequence renderer
+// Plays a decoded SEQ through the SPU voice model the way the player's native
+// sequencer does (same channel state, loop markers and tone selection) and
+// returns 16-bit stereo PCM at 44.1kHz. Output only depends on the inputs and
+// the options, so renders can be compared byte for byte.
+
+#ifndef RENDER_H
+#define RENDER_H
+
+#include "../seq_events.h"
+#include "vab.h"
+
+typedef struct {
+    int loops;               // Extra passes through the SEQ loop (0 = stop at the loop end)
+    int tick_rate;           // Snap events to the player's tick interrupt in Hz (0 = exact)
+    int tail_ms;             // Longest release tail rendered after the end
+} RenderOptions;
+
+typedef struct {
+    short* pcm;              // Stereo frames, malloc'd
+    u_int frames;
+    u_int capacity;
+    
+    // Voice statistics
+    int peak;
+    u_long steals;
+    u_long refused;
+} RenderResult;
+
+void renderDefaults(RenderOptions* options);
+
+// Render song with bank. Returns 0 on success, -1 if out of memory
+int renderSong(const SeqSong* song, const VabBank* bank, const RenderOptions* options, RenderResult* result);
+
+void renderFree(RenderResult* result);
+
+// Write 16-bit stereo PCM as a 44.1kHz WAV file. Returns 0 on success
+int writeWav(const char* path, const short* pcm, u_int frames);
+
+#endif // RENDER_H
@@ -0,0 +1,551 @@
+// seqrender - render SEQ files with VH/VB soundbanks to WAV files on the host
+//
+// Usage: seqrender [options] song.seq bank.vh [bank.vb]
+//        seqrender -b out_dir [-j threads] [options] [seq_dir [vh_dir]]
+//   -o file   Output WAV (default: song name with .wav)
+//   -l n      Play the SEQ loop n more times (default 0)
+//   -r hz     Snap events to the player's tick rate (default 240, 0 = exact)
+//   -t ms     Longest release tail after the end (default 5000)
+//   -b dir    Batch: render every .seq of seq_dir (default SEQ) with every .vh
+//             of vh_dir (default SOUNDBANK/VH) into dir/song_bank.wav
+//   -j n      Batch threads (default: one per CPU)
+//   -g file   Batch without WAVs: compare every render with the goldens in file
+//   -G file   Batch without WAVs: write every render to file as the new goldens
+//   -e n      Golden tolerance: largest RMS level change per window (default 64)
+//   -w        Golden check: changed samples with every level in tolerance only
+//             warn (by default they fail)
+//
+// The VB defaults to the VH path with SOUNDBANK/VH -> SOUNDBANK/VB and .vh -> .vb
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "../seq_events.h"
+#include "vab.h"
+#include "render.h"
+#include "spu.h"
+#include "pool.h"
+#include "golden.h"
+
+#define PATH_SIZE 512
+#define GOLDEN_TOLERANCE 64
+
+// Batch outputs
+#define BATCH_WAV 0
+#define BATCH_GOLDEN_CHECK 1
+#define BATCH_GOLDEN_UPDATE 2
+
+// Batch render of every song with every bank
+typedef struct {
+    int num_songs;
+    int num_banks;
+    char** song_paths;
+    char** bank_paths;
+    SeqSong* songs;
+    SeqEvent** events;       // NULL if the song did not load
+    VabBank* banks;          // Decoded once, read by every render
+    int* bank_ok;
+    GoldenHash* song_hash;
+    GoldenHash* bank_hash;
+    u_int* frames;           // Per job, for the summary
+    int* failed;
+    GoldenEntry* measured;   // Per job in golden modes
+    const RenderOptions* options;
+    int mode;                // BATCH_*
+    const char* out_dir;     // WAV directory or golden file
+} Batch;
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: seqrender [-o out.wav] [-l loops] [-r tick_hz] [-t tail_ms] song.seq bank.vh [bank.vb]\n"
+            "       seqrender -b out_dir [-j threads] [-l loops] [-r tick_hz] [-t tail_ms] [seq_dir [vh_dir]]\n"
+            "       seqrender -g|-G golden.txt [-j threads] [-e tolerance] [-w] [seq_dir [vh_dir]]\n");
+    exit(2);
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Replace the extension of path (or append one)
+static void replaceExtension(char* out, const char* path, const char* ext)
+{
+    char* dot;
+    char* slash;
+    
+    snprintf(out, PATH_SIZE, "%s", path);
+    dot = strrchr(out, '.');
+    slash = strrchr(out, '/');
+    if (dot && (!slash || dot > slash)) *dot = 0;
+    strncat(out, ext, PATH_SIZE - strlen(out) - 1);
+}
+
+// File name without directory (and without extension unless keep_ext)
+static void baseName(char* out, const char* path, int keep_ext)
+{
+    const char* slash = strrchr(path, '/');
+    char* dot;
+    
+    snprintf(out, PATH_SIZE, "%s", slash ? slash + 1 : path);
+    dot = strrchr(out, '.');
+    if (dot && !keep_ext) *dot = 0;
+}
+
+// SOUNDBANK/VH/name.vh -> SOUNDBANK/VB/name.vb
+static void vbPathFor(char* out, const char* vh_path)
+{
+    char* dir;
+    
+    replaceExtension(out, vh_path, ".vb");
+    dir = strstr(out, "VH/");
+    while (dir) {
+        char* next = strstr(dir + 1, "VH/");
+        if (!next) break;
+        dir = next;
+    }
+    if (dir) dir[1] = 'B';
+}
+
+// Load and decode a .seq file. events is malloc'd and owned by the caller
+static int loadSong(const char* path, SeqSong* song, SeqEvent** events, GoldenHash* hash)
+{
+    u_char* data;
+    u_int size;
+    int max_events;
+    
+    data = loadFile(path, &size);
+    if (!data) {
+        fprintf(stderr, "%s: cannot read\n", path);
+        return -1;
+    }
+    
+    // Every event takes at least two bytes (delta and data)
+    max_events = size / 2 + 2;
+    *events = malloc(max_events * sizeof(SeqEvent));
+    if (!*events || size < SEQ_HEADER_SIZE || seqDecode(data, size, *events, max_events, song) < 0) {
+        fprintf(stderr, "%s: not a valid SEQ\n", path);
+        free(*events);
+        *events = NULL;
+        free(data);
+        return -1;
+    }
+    
+    if (hash) *hash = goldenHash(data, size, GOLDEN_HASH_INIT);
+    free(data);
+    return 0;
+}
+
+// Load a .vh and its .vb, hashing both
+static int loadBank(const char* vh_path, VabBank* bank, GoldenHash* hash)
+{
+    char vb_path[PATH_SIZE];
+    u_char* vh;
+    u_char* vb;
+    u_int vh_size, vb_size;
+    int result = -1;
+    
+    vbPathFor(vb_path, vh_path);
+    vh = loadFile(vh_path, &vh_size);
+    vb = loadFile(vb_path, &vb_size);
+    if (!vh || !vb) {
+        fprintf(stderr, "%s: cannot read\n", vh ? vb_path : vh_path);
+    } else if (vabLoadMemory(bank, vh, vh_size, vb, vb_size) < 0) {
+        fprintf(stderr, "%s: not a valid VH\n", vh_path);
+    } else {
+        *hash = goldenHash(vb, vb_size, goldenHash(vh, vh_size, GOLDEN_HASH_INIT));
+        result = 0;
+    }
+    
+    free(vh);
+    free(vb);
+    return result;
+}
+
+static int comparePaths(const void* a, const void* b)
+{
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// Sorted paths of the files in dir with extension ext (any case)
+static char** listFiles(const char* dir, const char* ext, int* count)
+{
+    DIR* d = opendir(dir);
+    struct dirent* entry;
+    char** paths = NULL;
+    char** grown;
+    size_t len, ext_len = strlen(ext);
+    int capacity = 0;
+    
+    *count = 0;
+    if (!d) {
+        fprintf(stderr, "%s: cannot open\n", dir);
+        return NULL;
+    }
+    
+    while ((entry = readdir(d)) != NULL) {
+        len = strlen(entry->d_name);
+        if (len <= ext_len || strcasecmp(entry->d_name + len - ext_len, ext) != 0) continue;
+        
+        if (*count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            grown = realloc(paths, capacity * sizeof(char*));
+            if (!grown) break;
+            paths = grown;
+        }
+        paths[*count] = malloc(PATH_SIZE);
+        if (!paths[*count]) break;
+        snprintf(paths[*count], PATH_SIZE, "%s/%s", dir, entry->d_name);
+        (*count)++;
+    }
+    closedir(d);
+    
+    if (*count > 0) qsort(paths, *count, sizeof(char*), comparePaths);
+    return paths;
+}
+
+static void loadBankJob(int job, int thread, void* context)
+{
+    Batch* batch = context;
+    
+    (void)thread;
+    batch->bank_ok[job] = loadBank(batch->bank_paths[job], &batch->banks[job], &batch->bank_hash[job]) == 0;
+}
+
+static void renderJob(int job, int thread, void* context)
+{
+    Batch* batch = context;
+    int s = job / batch->num_banks;
+    int b = job % batch->num_banks;
+    RenderResult result;
+    char song_name[PATH_SIZE], bank_name[PATH_SIZE];
+    char path[PATH_SIZE * 3];
+    
+    (void)thread;
+    batch->failed[job] = 1;
+    if (!batch->events[s] || !batch->bank_ok[b]) return;
+    
+    baseName(song_name, batch->song_paths[s], batch->mode != BATCH_WAV);
+    baseName(bank_name, batch->bank_paths[b], batch->mode != BATCH_WAV);
+    snprintf(path, sizeof(path), "%s/%s_%s.wav", batch->out_dir, song_name, bank_name);
+    
+    if (renderSong(&batch->songs[s], &batch->banks[b], batch->options, &result) < 0) {
+        fprintf(stderr, "%s: out of memory\n", path);
+        return;
+    }
+    
+    if (batch->mode != BATCH_WAV) {
+        // Reported in job order once every render is done
+        GoldenEntry* entry = &batch->measured[job];
+        
+        entry->song_hash = batch->song_hash[s];
+        entry->bank_hash = batch->bank_hash[b];
+        snprintf(entry->song, GOLDEN_NAME_SIZE, "%.*s", GOLDEN_NAME_SIZE - 1, song_name);
+        snprintf(entry->bank, GOLDEN_NAME_SIZE, "%.*s", GOLDEN_NAME_SIZE - 1, bank_name);
+        if (goldenMeasure(entry, result.pcm, result.frames) == 0) {
+            batch->frames[job] = result.frames;
+            batch->failed[job] = 0;
+        }
+    } else if (writeWav(path, result.pcm, result.frames) < 0) {
+        fprintf(stderr, "%s: cannot write\n", path);
+    } else {
+        printf("%s: %.2fs, peak %d voices, %lu stolen, %lu dropped\n", path,
+               (double)result.frames / SPU_RATE, result.peak, result.steals, result.refused);
+        batch->frames[job] = result.frames;
+        batch->failed[job] = 0;
+    }
+    renderFree(&result);
+}
+
+// Tick of the song at an output frame (first pass through the song)
+static u_int frameToTick(const SeqSong* song, u_int frame)
+{
+    SeqTempoEntry* map = malloc((song->num_events + 1) * sizeof(SeqTempoEntry));
+    unsigned long long time = (unsigned long long)frame * song->resolution * 1000000 / SPU_RATE;
+    u_int tick = 0;
+    int count;
+    
+    if (map) {
+        count = seqBuildTempoMap(song, map, song->num_events + 1);
+        tick = seqTimeToTick(map, count, time);
+        free(map);
+    }
+    return tick;
+}
+
+// Compare every render with the goldens. Returns the number of failures,
+// *warnings the renders whose samples changed with levels in tolerance if
+// those only warn
+static int goldenCheck(Batch* batch, const GoldenSet* golden, int tolerance, int warn, int* warnings)
+{
+    const GoldenEntry* entry;
+    const GoldenEntry* gold;
+    int jobs = batch->num_songs * batch->num_banks;
+    int failures = 0;
+    int job, window, diff, edited;
+    
+    *warnings = 0;
+    for (job = 0; job < jobs; job++) {
+        if (batch->failed[job]) continue;
+        entry = &batch->measured[job];
+        gold = goldenFind(golden, entry, &edited);
+        
+        if (!gold) {
+            printf("NEW  %s + %s: no golden\n", entry->song, entry->bank);
+            failures++;
+            continue;
+        }
+        
+        window = goldenCompare(gold, entry, tolerance, &diff);
+        if (window >= 0) {
+            printf("FAIL %s + %s%s: window %d (%.1fs, tick %u) RMS %d vs golden %d\n",
+                   entry->song, entry->bank, edited ? " (inputs edited)" : "", window,
+                   window * GOLDEN_WINDOW_MS / 1000.0,
+                   frameToTick(&batch->songs[job / batch->num_banks], window * GOLDEN_WINDOW_FRAMES),
+                   window < entry->num_windows ? entry->rms[window] : 0,
+                   window < gold->num_windows ? gold->rms[window] : 0);
+            failures++;
+        } else if ((window = goldenFirstChange(gold, entry)) >= 0) {
+            // Same loudness, other samples: pitch, sample or timing changes show up here
+            if (!gold->window_hash) {
+                printf("%s %s + %s%s: samples change (version 1 golden, no windows), levels within tolerance\n",
+                       warn ? "WARN" : "FAIL", entry->song, entry->bank, edited ? " (inputs edited)" : "");
+            } else {
+                printf("%s %s + %s%s: samples change at window %d (%.1fs, tick %u), levels within tolerance\n",
+                       warn ? "WARN" : "FAIL", entry->song, entry->bank, edited ? " (inputs edited)" : "",
+                       window, window * GOLDEN_WINDOW_MS / 1000.0,
+                       frameToTick(&batch->songs[job / batch->num_banks], window * GOLDEN_WINDOW_FRAMES));
+            }
+            if (warn) {
+                (*warnings)++;
+            } else {
+                failures++;
+            }
+        } else {
+            printf("ok   %s + %s%s\n", entry->song, entry->bank, edited ? " (inputs edited)" : "");
+        }
+    }
+    
+    return failures;
+}
+
+static int batchMain(const char* out_dir, int mode, int threads, const RenderOptions* options,
+                     int tolerance, int warn, const char* seq_dir, const char* vh_dir)
+{
+    GoldenSet golden;
+    Batch batch;
+    double start, load_time, elapsed, length = 0;
+    int jobs, failed = 0;
+    int warnings;
+    int i;
+    
+    memset(&batch, 0, sizeof(batch));
+    batch.mode = mode;
+    batch.out_dir = out_dir;
+    
+    // Goldens are checked with the options they were made with
+    if (mode == BATCH_GOLDEN_CHECK) {
+        if (goldenLoad(&golden, out_dir) < 0) {
+            fprintf(stderr, "%s: not a golden file\n", out_dir);
+            return 1;
+        }
+        options = &golden.options;
+    }
+    batch.options = options;
+    batch.song_paths = listFiles(seq_dir, ".seq", &batch.num_songs);
+    batch.bank_paths = listFiles(vh_dir, ".vh", &batch.num_banks);
+    if (batch.num_songs == 0 || batch.num_banks == 0) {
+        fprintf(stderr, "nothing to render (%d .seq in %s, %d .vh in %s)\n",
+                batch.num_songs, seq_dir, batch.num_banks, vh_dir);
+        return 1;
+    }
+    if (mode == BATCH_WAV) mkdir(out_dir, 0755);
+    
+    jobs = batch.num_songs * batch.num_banks;
+    batch.songs = calloc(batch.num_songs, sizeof(SeqSong));
+    batch.events = calloc(batch.num_songs, sizeof(SeqEvent*));
+    batch.banks = calloc(batch.num_banks, sizeof(VabBank));
+    batch.bank_ok = calloc(batch.num_banks, sizeof(int));
+    batch.frames = calloc(jobs, sizeof(u_int));
+    batch.failed = calloc(jobs, sizeof(int));
+    batch.song_hash = calloc(batch.num_songs, sizeof(GoldenHash));
+    batch.bank_hash = calloc(batch.num_banks, sizeof(GoldenHash));
+    batch.measured = calloc(jobs, sizeof(GoldenEntry));
+    if (!batch.songs || !batch.events || !batch.banks || !batch.bank_ok || !batch.frames || !batch.failed ||
+        !batch.song_hash || !batch.bank_hash || !batch.measured) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    if (threads <= 0) threads = poolCpuCount();
+    
+    // Songs are small and decode fast, banks are decoded once on the pool and
+    // then shared read-only by every render that uses them
+    start = now();
+    for (i = 0; i < batch.num_songs; i++) {
+        loadSong(batch.song_paths[i], &batch.songs[i], &batch.events[i], &batch.song_hash[i]);
+    }
+    poolRun(threads, batch.num_banks, loadBankJob, &batch);
+    load_time = now() - start;
+    
+    poolRun(threads, jobs, renderJob, &batch);
+    elapsed = now() - start;
+    
+    for (i = 0; i < jobs; i++) {
+        failed += batch.failed[i];
+        length += (double)batch.frames[i] / SPU_RATE;
+    }
+    printf("%d songs x %d banks: %d rendered, %d failed, %.1fs of audio in %.2fs "
+           "(%.2fs loading, %d threads, %.0fx real time)\n",
+           batch.num_songs, batch.num_banks, jobs - failed, failed, length, elapsed,
+           load_time, threads, elapsed > 0 ? length / elapsed : 0.0);
+    
+    if (mode == BATCH_GOLDEN_CHECK) {
+        i = goldenCheck(&batch, &golden, tolerance, warn, &warnings);
+        if (warn) {
+            printf("%s: %d of %d renders differ from the goldens, %d more changed within tolerance\n",
+                   out_dir, i, jobs - failed, warnings);
+        } else {
+            printf("%s: %d of %d renders differ from the goldens\n", out_dir, i, jobs - failed);
+        }
+        failed += i;
+        goldenFree(&golden);
+    } else if (mode == BATCH_GOLDEN_UPDATE) {
+        memset(&golden, 0, sizeof(golden));
+        golden.options = *options;
+        for (i = 0; i < jobs; i++) {
+            if (!batch.failed[i]) goldenAdd(&golden, &batch.measured[i]);
+        }
+        if (goldenSave(&golden, out_dir) < 0) {
+            fprintf(stderr, "%s: cannot write\n", out_dir);
+            failed++;
+        } else {
+            printf("%s: %d goldens written\n", out_dir, golden.count);
+        }
+        goldenFree(&golden);
+    }
+    
+    for (i = 0; i < batch.num_banks; i++) {
+        if (batch.bank_ok[i]) vabFree(&batch.banks[i]);
+        free(batch.bank_paths[i]);
+    }
+    for (i = 0; i < batch.num_songs; i++) {
+        free(batch.events[i]);
+        free(batch.song_paths[i]);
+    }
+    free(batch.song_paths);
+    free(batch.bank_paths);
+    free(batch.songs);
+    free(batch.events);
+    free(batch.banks);
+    free(batch.bank_ok);
+    for (i = 0; i < jobs; i++) {
+        free(batch.measured[i].rms);
+        free(batch.measured[i].window_hash);
+    }
+    free(batch.frames);
+    free(batch.failed);
+    free(batch.song_hash);
+    free(batch.bank_hash);
+    free(batch.measured);
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char** argv)
+{
+    RenderOptions options;
+    RenderResult result;
+    VabBank* bank;
+    SeqSong song;
+    SeqEvent* events;
+    const char* out_path = NULL;
+    const char* batch_dir = NULL;
+    const char* seq_path;
+    const char* vh_path;
+    char vb_path[PATH_SIZE];
+    char wav_path[PATH_SIZE];
+    double start, elapsed, length;
+    int mode = BATCH_WAV;
+    int threads = 0;
+    int tolerance = GOLDEN_TOLERANCE;
+    int warn = 0;
+    int i;
+    
+    renderDefaults(&options);
+    
+    for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+        if (argv[i][1] == 'w') {
+            warn = 1;
+            continue;
+        }
+        if (i + 1 >= argc) usage();
+        switch (argv[i][1]) {
+            case 'o': out_path = argv[++i]; break;
+            case 'l': options.loops = atoi(argv[++i]); break;
+            case 'r': options.tick_rate = atoi(argv[++i]); break;
+            case 't': options.tail_ms = atoi(argv[++i]); break;
+            case 'b': batch_dir = argv[++i]; break;
+            case 'j': threads = atoi(argv[++i]); break;
+            case 'g': batch_dir = argv[++i]; mode = BATCH_GOLDEN_CHECK; break;
+            case 'G': batch_dir = argv[++i]; mode = BATCH_GOLDEN_UPDATE; break;
+            case 'e': tolerance = atoi(argv[++i]); break;
+            default: usage();
+        }
+    }
+    
+    if (batch_dir) {
+        if (argc - i > 2) usage();
+        return batchMain(batch_dir, mode, threads, &options, tolerance, warn,
+                         argc - i > 0 ? argv[i] : "SEQ",
+                         argc - i > 1 ? argv[i + 1] : "SOUNDBANK/VH");
+    }
+    
+    if (argc - i < 2 || argc - i > 3) usage();
+    
+    seq_path = argv[i];
+    vh_path = argv[i + 1];
+    if (argc - i == 3) {
+        snprintf(vb_path, PATH_SIZE, "%s", argv[i + 2]);
+    } else {
+        vbPathFor(vb_path, vh_path);
+    }
+    if (!out_path) {
+        replaceExtension(wav_path, seq_path, ".wav");
+        out_path = wav_path;
+    }
+    
+    bank = malloc(sizeof(VabBank));
+    if (!bank || vabLoad(bank, vh_path, vb_path) < 0) return 1;
+    if (loadSong(seq_path, &song, &events, NULL) < 0) return 1;
+    
+    start = now();
+    if (renderSong(&song, bank, &options, &result) < 0) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    elapsed = now() - start;
+    length = (double)result.frames / SPU_RATE;
+    
+    if (writeWav(out_path, result.pcm, result.frames) < 0) {
+        fprintf(stderr, "%s: cannot write\n", out_path);
+        return 1;
+    }
+    
+    printf("%s: %.2fs, peak %d voices, %lu stolen, %lu dropped (%.0fx real time)\n",
+           out_path, length, result.peak, result.steals, result.refused,
+           elapsed > 0 ? length / elapsed : 0.0);
+    
+    renderFree(&result);
+    vabFree(bank);
+    free(bank);
+    free(events);
+    return 0;
+}
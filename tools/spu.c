@@ -0,0 +1,184 @@
+// Host SPU voice model (see spu.h)
+
+#include <math.h>
+#include <string.h>
+#include <sys/types.h>
+#include "spu.h"
+
+void spuInit(Spu* spu)
+{
+    int v;
+    
+    spuEnvInit();
+    memset(spu, 0, sizeof(Spu));
+    spu->main_vol = SPU_VOLUME_MAX;
+    for (v = 0; v < SPU_VOICES; v++) {
+        spu->voice[v].channel = -1;
+    }
+}
+
+// ====================
+// Voice allocation
+// ====================
+
+static void voiceSetState(Spu* spu, SpuVoice* voice, int state)
+{
+    if (voice->state == SPU_VOICE_HELD) spu->active--;
+    voice->state = state;
+    if (state == SPU_VOICE_HELD) {
+        spu->active++;
+        if (spu->active > spu->peak) spu->peak = spu->active;
+    }
+}
+
+int spuAlloc(Spu* spu, int prior)
+{
+    SpuVoice* v;
+    int best = -1;
+    int best_class = 32;
+    int i, cls;
+    
+    prior &= 0x0F;
+    
+    // Free voices and released voices whose envelope ended
+    for (i = 0; i < SPU_VOICES; i++) {
+        v = &spu->voice[i];
+        if (v->state == SPU_VOICE_RELEASED && v->env.phase == ENV_OFF) {
+            voiceSetState(spu, v, SPU_VOICE_FREE);
+        }
+        if (v->state == SPU_VOICE_FREE) {
+            best = i;
+            break;
+        }
+    }
+    
+    // Otherwise the oldest voice of the lowest class: released voices by
+    // priority, then held voices up to the new note's priority
+    if (best < 0) {
+        for (i = 0; i < SPU_VOICES; i++) {
+            v = &spu->voice[i];
+            cls = (v->state - 1) * 16 + v->prior;
+            if (cls > 16 + prior) continue;
+            if (cls < best_class || (cls == best_class && v->age < spu->voice[best].age)) {
+                best = i;
+                best_class = cls;
+            }
+        }
+        if (best < 0) {
+            spu->refused++;
+            return -1;
+        }
+        if (spu->voice[best].state == SPU_VOICE_HELD) {
+            spu->steals++;
+        }
+    }
+    
+    v = &spu->voice[best];
+    voiceSetState(spu, v, SPU_VOICE_HELD);
+    v->prior = prior;
+    v->age = spu->serial++;
+    v->channel = -1;
+    return best;
+}
+
+void spuKeyOn(Spu* spu, int voice, const VabSample* sample, int pitch, int vol_l, int vol_r, u_short adsr1, u_short adsr2)
+{
+    SpuVoice* v = &spu->voice[voice];
+    
+    v->sample = sample;
+    v->pos = 0;
+    v->frac = 0;
+    v->pitch = pitch > 0x3FFF ? 0x3FFF : pitch;
+    v->vol_l = vol_l;
+    v->vol_r = vol_r;
+    spuEnvKeyOn(&v->env, adsr1, adsr2);
+}
+
+void spuKeyOff(Spu* spu, int voice)
+{
+    SpuVoice* v = &spu->voice[voice];
+    
+    spuEnvKeyOff(&v->env);
+    if (v->state == SPU_VOICE_HELD) {
+        voiceSetState(spu, v, SPU_VOICE_RELEASED);
+        v->age = spu->serial++;  // Released voices are taken in key-off order, as by the player
+    }
+    v->channel = -1;
+}
+
+int spuNotePitch(const VabTone* tone, int note, int bend)
+{
+    // Semitones from the tone's center note, fine tune in 1/128 semitone
+    double semitones = (note - tone->center) + tone->shift / 128.0;
+    
+    if (bend > 64) {
+        semitones += (bend - 64) * tone->pbmax / 63.0;
+    } else if (bend < 64) {
+        semitones -= (64 - bend) * tone->pbmin / 64.0;
+    }
+    
+    return (int)(SPU_PITCH_BASE * pow(2.0, semitones / 12.0) + 0.5);
+}
+
+// ====================
+// Mixing
+// ====================
+
+int spuMix(Spu* spu, short* out, int frames)
+{
+    int f, i, sounding = 0;
+    int left, right, s, s0, s1;
+    SpuVoice* v;
+    
+    for (f = 0; f < frames; f++) {
+        left = 0;
+        right = 0;
+        
+        for (i = 0; i < SPU_VOICES; i++) {
+            v = &spu->voice[i];
+            if (v->env.phase == ENV_OFF || !v->sample) continue;
+            
+            // Linear interpolation between the current and next sample
+            s0 = v->sample->pcm[v->pos];
+            s1 = (v->pos + 1 < (u_int)v->sample->length) ? v->sample->pcm[v->pos + 1] : s0;
+            s = s0 + (((s1 - s0) * (int)v->frac) >> 12);
+            
+            s = (s * v->env.level) >> 15;
+            left += (s * v->vol_l) >> 14;
+            right += (s * v->vol_r) >> 14;
+            
+            spuEnvStep(&v->env);
+            
+            // Pitch counter: 12-bit fraction, pitch 0x1000 = one sample per output sample
+            v->frac += v->pitch;
+            v->pos += v->frac >> 12;
+            v->frac &= 0xFFF;
+            if (v->pos >= (u_int)v->sample->length) {
+                if (v->sample->loops) {
+                    // Repeat address, or the start of the sample without a loop block
+                    v->pos = (v->sample->loop_start >= 0 ? v->sample->loop_start : 0) +
+                             (v->pos - v->sample->length);
+                    if (v->pos >= (u_int)v->sample->length) v->pos = 0;
+                } else {
+                    // End without repeat: the SPU silences the voice
+                    v->env.phase = ENV_OFF;
+                    v->env.level = 0;
+                }
+            }
+        }
+        
+        left = (left * spu->main_vol) >> 14;
+        right = (right * spu->main_vol) >> 14;
+        if (left > 32767) left = 32767;
+        if (left < -32768) left = -32768;
+        if (right > 32767) right = 32767;
+        if (right < -32768) right = -32768;
+        out[f * 2] = (short)left;
+        out[f * 2 + 1] = (short)right;
+    }
+    
+    for (i = 0; i < SPU_VOICES; i++) {
+        if (spu->voice[i].env.phase != ENV_OFF) sounding++;
+    }
+    return sounding;
+}
@@ -0,0 +1,67 @@
+// Host SPU voice model
+// 24 voices playing decoded VAB samples with the SPU pitch counter, ADSR
+// envelope and volume, mixed to 16-bit stereo at 44.1kHz. Voices are assigned
+// with the same priority/release/age rules as the player's voice allocator.
+//
+// Not modelled: reverb, noise, FM, sweep volumes, and the SPU's 4-point
+// gaussian interpolation (linear interpolation is used instead).
+
+#ifndef SPU_H
+#define SPU_H
+
+#include "vab.h"
+#include "../spu_env.h"
+
+#define SPU_VOICES 24
+#define SPU_RATE 44100
+#define SPU_PITCH_BASE 0x1000      // Pitch register value that plays at 44.1kHz
+#define SPU_VOLUME_MAX 0x3FFF
+
+// Allocator states
+#define SPU_VOICE_FREE 0
+#define SPU_VOICE_RELEASED 1
+#define SPU_VOICE_HELD 2
+
+typedef struct {
+    const VabSample* sample;
+    u_int pos;               // Current sample
+    u_int frac;              // Position between samples, 12 bits
+    int pitch;               // 0-0x3FFF
+    int vol_l, vol_r;        // 0-0x3FFF
+    SpuEnvelope env;
+    
+    // Allocation and ownership
+    int state;               // SPU_VOICE_*
+    int prior;
+    u_long age;              // Serial number of the key-on, or of the key-off once released
+    int channel;             // -1 = not owned by a sequence channel
+    int note;
+    const VabTone* tone;
+} SpuVoice;
+
+typedef struct {
+    SpuVoice voice[SPU_VOICES];
+    u_long serial;
+    int main_vol;            // Master volume 0-0x3FFF
+    int active;              // Held voices
+    int peak;
+    u_long steals;
+    u_long refused;
+} Spu;
+
+void spuInit(Spu* spu);
+
+// Pick a voice for a new note of priority prior (0-15). Returns -1 if every
+// voice is held by a higher priority note
+int spuAlloc(Spu* spu, int prior);
+
+void spuKeyOn(Spu* spu, int voice, const VabSample* sample, int pitch, int vol_l, int vol_r, u_short adsr1, u_short adsr2);
+void spuKeyOff(Spu* spu, int voice);
+
+// Pitch register for a note played by tone (bend 0-127, 64 = center)
+int spuNotePitch(const VabTone* tone, int note, int bend);
+
+// Mix frames stereo samples into out. Returns the number of voices still sounding
+int spuMix(Spu* spu, short* out, int frames);
+
+#endif // SPU_H
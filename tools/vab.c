@@ -0,0 +1,172 @@
+// Host-side soundbank loading (see vab.h)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include "vag.h"
+#include "vab.h"
+
+// VH layout
+#define VH_HEADER_SIZE 32
+#define VH_PROG_SIZE 16
+#define VH_TONE_SIZE 32
+
+#define LE16(p) ((p)[0] | ((p)[1] << 8))
+
+u_char* loadFile(const char* path, u_int* size)
+{
+    FILE* f = fopen(path, "rb");
+    u_char* data;
+    long length;
+    
+    if (!f) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    length = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    
+    data = malloc(length > 0 ? length : 1);
+    if (data && fread(data, 1, length, f) != (size_t)length) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    
+    *size = (u_int)length;
+    return data;
+}
+
+int vabLoadMemory(VabBank* bank, const u_char* vh, u_int vh_size, const u_char* vb, u_int vb_size)
+{
+    const u_char* progs = vh + VH_HEADER_SIZE;
+    const u_char* tones = progs + VAB_MAX_PROGRAMS * VH_PROG_SIZE;
+    const u_char* sizes;
+    u_int offset, vag_size, total = 0;
+    int i, t, block = 0;
+    short* out;
+    VagStream* streams;
+    
+    memset(bank, 0, sizeof(VabBank));
+    
+    if (vh_size < VH_HEADER_SIZE || memcmp(vh, "pBAV", 4) != 0) {
+        return -1;
+    }
+    bank->num_programs = LE16(vh + 18);
+    bank->num_tones = LE16(vh + 20);
+    bank->num_vags = LE16(vh + 22);
+    bank->mvol = vh[24];
+    bank->pan = vh[25];
+    
+    // Tone blocks follow the program table, one per program with tones
+    sizes = tones + bank->num_programs * VAB_MAX_TONES * VH_TONE_SIZE;
+    if (bank->num_vags >= VAB_MAX_VAGS || sizes + VAB_MAX_VAGS * 2 > vh + vh_size) {
+        return -1;
+    }
+    
+    for (i = 0; i < VAB_MAX_PROGRAMS; i++) {
+        const u_char* p = progs + i * VH_PROG_SIZE;
+        VabProgram* prog = &bank->program[i];
+        
+        if (p[0] == 0 || block >= bank->num_programs) continue;
+        
+        prog->tones = p[0] > VAB_MAX_TONES ? VAB_MAX_TONES : p[0];
+        prog->mvol = p[1];
+        prog->mpan = p[4];
+        for (t = 0; t < prog->tones; t++) {
+            const u_char* a = tones + (block * VAB_MAX_TONES + t) * VH_TONE_SIZE;
+            VabTone* tone = &prog->tone[t];
+            
+            tone->prior = a[0];
+            tone->vol = a[2];
+            tone->pan = a[3];
+            tone->center = a[4];
+            tone->shift = a[5];
+            tone->min = a[6];
+            tone->max = a[7];
+            tone->pbmin = a[12];
+            tone->pbmax = a[13];
+            tone->adsr1 = LE16(a + 16);
+            tone->adsr2 = LE16(a + 18);
+            tone->vag = (short)LE16(a + 22);
+        }
+        block++;
+    }
+    
+    // VAG sizes are stored / 8, entry 0 is unused
+    for (i = 1; i <= bank->num_vags; i++) {
+        total += (LE16(sizes + i * 2) << 3) / VAG_BLOCK_SIZE * VAG_BLOCK_SAMPLES;
+    }
+    bank->pcm = malloc((total ? total : 1) * sizeof(short));
+    if (!bank->pcm) {
+        return -1;
+    }
+    
+    // Decode all VAGs together so the vector decoder gets independent streams
+    streams = malloc((bank->num_vags + 1) * sizeof(VagStream));
+    if (!streams) {
+        return -1;
+    }
+    out = bank->pcm;
+    offset = 0;
+    for (i = 1; i <= bank->num_vags; i++) {
+        VabSample* s = &bank->sample[i];
+        VagStream* stream = &streams[i - 1];
+        
+        vag_size = LE16(sizes + i * 2) << 3;
+        if (offset + vag_size > vb_size) {
+            vag_size = offset < vb_size ? vb_size - offset : 0;
+        }
+        stream->data = vb + offset;
+        stream->blocks = vagScan(vb + offset, vag_size, &s->loop_start, &s->loops);
+        stream->out = out;
+        stream->state.s1 = 0;
+        stream->state.s2 = 0;
+        
+        s->pcm = out;
+        s->length = stream->blocks * VAG_BLOCK_SAMPLES;
+        out += s->length;
+        offset += LE16(sizes + i * 2) << 3;
+    }
+    vagDecodeStreams(streams, bank->num_vags);
+    free(streams);
+    bank->vb_size = vb_size;
+    
+    return 0;
+}
+
+int vabLoad(VabBank* bank, const char* vh_path, const char* vb_path)
+{
+    u_char* vh;
+    u_char* vb;
+    u_int vh_size, vb_size;
+    int result;
+    
+    vh = loadFile(vh_path, &vh_size);
+    if (!vh) {
+        fprintf(stderr, "%s: cannot read\n", vh_path);
+        return -1;
+    }
+    vb = loadFile(vb_path, &vb_size);
+    if (!vb) {
+        fprintf(stderr, "%s: cannot read\n", vb_path);
+        free(vh);
+        return -1;
+    }
+    
+    result = vabLoadMemory(bank, vh, vh_size, vb, vb_size);
+    if (result < 0) {
+        fprintf(stderr, "%s: not a valid VH\n", vh_path);
+    }
+    
+    free(vh);
+    free(vb);
+    return result;
+}
+
+void vabFree(VabBank* bank)
+{
+    free(bank->pcm);
+    bank->pcm = NULL;
+}
@@ -0,0 +1,64 @@
+// Host-side soundbank loading
+// Parses a .vh (VabHdr, ProgAtr[128], VagAtr blocks, VAG size table) and
+// decodes every VAG of the matching .vb to PCM once. A loaded bank is only
+// read while rendering, so one copy can be shared by any number of renders.
+
+#ifndef VAB_H
+#define VAB_H
+
+#define VAB_MAX_PROGRAMS 128
+#define VAB_MAX_TONES 16
+#define VAB_MAX_VAGS 256
+
+// Tone (VagAtr fields the renderer uses)
+typedef struct {
+    u_char prior;
+    u_char vol;
+    u_char pan;
+    u_char center;           // Note played at the sample's own pitch
+    u_char shift;            // Fine tune in 1/128 semitone
+    u_char min, max;         // Note range
+    u_char pbmin, pbmax;     // Pitch bend range in semitones
+    u_short adsr1, adsr2;
+    short vag;               // 1-based index into the VAG table
+} VabTone;
+
+typedef struct {
+    int tones;               // Tones in this program (0 = unused)
+    u_char mvol;
+    u_char mpan;
+    VabTone tone[VAB_MAX_TONES];
+} VabProgram;
+
+// Decoded sample
+typedef struct {
+    short* pcm;              // Points into VabBank.pcm
+    int length;              // Samples
+    int loop_start;          // Repeat sample (-1 = start of the sample)
+    int loops;               // Ends with a repeat block
+} VabSample;
+
+typedef struct {
+    u_char mvol;
+    u_char pan;
+    int num_programs;        // ps
+    int num_tones;           // ts
+    int num_vags;            // vs
+    VabProgram program[VAB_MAX_PROGRAMS];
+    VabSample sample[VAB_MAX_VAGS];
+    short* pcm;              // All decoded samples
+    u_int vb_size;
+} VabBank;
+
+// Load a .vh/.vb pair. Returns 0 on success, -1 with a message on stderr
+int vabLoad(VabBank* bank, const char* vh_path, const char* vb_path);
+
+// Load from memory (vh/vb must stay valid only during the call)
+int vabLoadMemory(VabBank* bank, const u_char* vh, u_int vh_size, const u_char* vb, u_int vb_size);
+
+void vabFree(VabBank* bank);
+
+// Read a whole file into a malloc'd buffer. Returns NULL on error
+u_char* loadFile(const char* path, u_int* size);
+
+#endif // VAB_H
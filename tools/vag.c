@@ -0,0 +1,324 @@
+// VAG ADPCM decoding (see vag.h)
+
+#include <sys/types.h>
+#include "vag.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define VAG_SIMD "AVX2"
+#define VAG_LANES 16
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define VAG_SIMD "SSE2"
+#define VAG_LANES 8
+#else
+#define VAG_SIMD "scalar"
+#define VAG_LANES 1
+#endif
+
+// Prediction filters in 1/64 units
+static const int vag_filter_pos[5] = { 0, 60, 115, 98, 122 };
+static const int vag_filter_neg[5] = { 0, 0, -52, -55, -60 };
+
+// Shift and filter of a block, with the SPU's handling of the unused values
+static void vagBlockHeader(const u_char* block, int* shift, int* filter)
+{
+    *shift = block[0] & 0x0F;
+    *filter = (block[0] >> 4) & 0x07;
+    
+    // The SPU treats shift 13-15 as 9 and filters 5-7 as 4
+    if (*shift > 12) *shift = 9;
+    if (*filter > 4) *filter = 4;
+}
+
+// Sample i of a block before prediction: nibble sign-extended from the top of
+// a 16-bit word, then shifted down
+#define VAG_RAW(block, i, shift) \
+    ((short)((((block)[2 + ((i) >> 1)] >> (((i) & 1) << 2)) & 0x0F) << 12) >> (shift))
+
+void vagDecodeBlock(const u_char* block, short* out, VagState* state)
+{
+    int shift, filter, pos, neg;
+    int s1 = state->s1;
+    int s2 = state->s2;
+    int i, sample;
+    
+    vagBlockHeader(block, &shift, &filter);
+    pos = vag_filter_pos[filter];
+    neg = vag_filter_neg[filter];
+    
+    for (i = 0; i < VAG_BLOCK_SAMPLES; i++) {
+        sample = VAG_RAW(block, i, shift) + ((s1 * pos + s2 * neg + 32) >> 6);
+        if (sample > 32767) sample = 32767;
+        if (sample < -32768) sample = -32768;
+        
+        out[i] = (short)sample;
+        s2 = s1;
+        s1 = sample;
+    }
+    
+    state->s1 = s1;
+    state->s2 = s2;
+}
+
+#if VAG_LANES > 1
+// Vector decoding: one stream per 16-bit lane. Blocks are unpacked per lane,
+// transposed to one vector per sample position, filtered, and transposed
+// back. Per sample the (s1, s2) history pairs meet the (pos, neg) filter in
+// one multiply-add, the nibble is added as raw * 64 + 32 before the shift
+// (exact, since raw * 64 has no low bits), and packing to 16 bits saturates
+// exactly like the SPU's clamp. The two halves of each vector are
+// independent chains, which hides the multiply latency.
+
+#if VAG_LANES == 16
+typedef __m256i VagVec;
+#define VEC_SET1(x) _mm256_set1_epi16(x)
+#define VEC_UNPACKLO _mm256_unpacklo_epi16
+#define VEC_UNPACKHI _mm256_unpackhi_epi16
+#define VEC_MADD _mm256_madd_epi16
+#define VEC_ADD _mm256_add_epi32
+#define VEC_SRAI _mm256_srai_epi32
+#define VEC_PACKS _mm256_packs_epi32
+#define VEC_LOAD(p) _mm256_loadu_si256((const __m256i*)(p))
+#define VEC_STORE(p, v) _mm256_storeu_si256((__m256i*)(p), v)
+#else
+typedef __m128i VagVec;
+#define VEC_SET1(x) _mm_set1_epi16(x)
+#define VEC_UNPACKLO _mm_unpacklo_epi16
+#define VEC_UNPACKHI _mm_unpackhi_epi16
+#define VEC_MADD _mm_madd_epi16
+#define VEC_ADD _mm_add_epi32
+#define VEC_SRAI _mm_srai_epi32
+#define VEC_PACKS _mm_packs_epi32
+#define VEC_LOAD(p) _mm_loadu_si128((const __m128i*)(p))
+#define VEC_STORE(p, v) _mm_storeu_si128((__m128i*)(p), v)
+#endif
+
+static const u_char vag_silent_block[VAG_BLOCK_SIZE] = { 0 };
+
+static void transpose8x8(__m128i* r)
+{
+    __m128i a0 = _mm_unpacklo_epi16(r[0], r[1]);
+    __m128i a1 = _mm_unpackhi_epi16(r[0], r[1]);
+    __m128i a2 = _mm_unpacklo_epi16(r[2], r[3]);
+    __m128i a3 = _mm_unpackhi_epi16(r[2], r[3]);
+    __m128i a4 = _mm_unpacklo_epi16(r[4], r[5]);
+    __m128i a5 = _mm_unpackhi_epi16(r[4], r[5]);
+    __m128i a6 = _mm_unpacklo_epi16(r[6], r[7]);
+    __m128i a7 = _mm_unpackhi_epi16(r[6], r[7]);
+    __m128i b0 = _mm_unpacklo_epi32(a0, a2);
+    __m128i b1 = _mm_unpackhi_epi32(a0, a2);
+    __m128i b2 = _mm_unpacklo_epi32(a1, a3);
+    __m128i b3 = _mm_unpackhi_epi32(a1, a3);
+    __m128i b4 = _mm_unpacklo_epi32(a4, a6);
+    __m128i b5 = _mm_unpackhi_epi32(a4, a6);
+    __m128i b6 = _mm_unpacklo_epi32(a5, a7);
+    __m128i b7 = _mm_unpackhi_epi32(a5, a7);
+    
+    r[0] = _mm_unpacklo_epi64(b0, b4);
+    r[1] = _mm_unpackhi_epi64(b0, b4);
+    r[2] = _mm_unpacklo_epi64(b1, b5);
+    r[3] = _mm_unpackhi_epi64(b1, b5);
+    r[4] = _mm_unpacklo_epi64(b2, b6);
+    r[5] = _mm_unpackhi_epi64(b2, b6);
+    r[6] = _mm_unpacklo_epi64(b3, b7);
+    r[7] = _mm_unpackhi_epi64(b3, b7);
+}
+
+// Unpack the 28 nibbles of a block into raw[0..31] (sign-extended and shifted)
+static void vagUnpack(const u_char* block, int shift, short* raw)
+{
+    __m128i mask = _mm_set1_epi8(0x0F);
+    __m128i zero = _mm_setzero_si128();
+    __m128i count = _mm_cvtsi32_si128(shift);
+    __m128i bytes = _mm_srli_si128(_mm_loadu_si128((const __m128i*)block), 2);
+    __m128i lo = _mm_and_si128(bytes, mask);
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(bytes, 4), mask);
+    __m128i nibbles;
+    
+    // Nibble into the top of a 16-bit lane (byte << 8, then << 4), then arithmetic shift
+    nibbles = _mm_unpacklo_epi8(lo, hi);
+    _mm_storeu_si128((__m128i*)raw, _mm_sra_epi16(_mm_slli_epi16(_mm_unpacklo_epi8(zero, nibbles), 4), count));
+    _mm_storeu_si128((__m128i*)(raw + 8), _mm_sra_epi16(_mm_slli_epi16(_mm_unpackhi_epi8(zero, nibbles), 4), count));
+    nibbles = _mm_unpackhi_epi8(lo, hi);
+    _mm_storeu_si128((__m128i*)(raw + 16), _mm_sra_epi16(_mm_slli_epi16(_mm_unpacklo_epi8(zero, nibbles), 4), count));
+    _mm_storeu_si128((__m128i*)(raw + 24), _mm_sra_epi16(_mm_slli_epi16(_mm_unpackhi_epi8(zero, nibbles), 4), count));
+}
+
+static void vagDecodeLanes(VagStream* streams, int count)
+{
+    short raw[VAG_LANES][32];              // Per lane, then per sample position
+    short pos[VAG_LANES], neg[VAG_LANES];
+    short hist1[VAG_LANES], hist2[VAG_LANES];
+    short column[32][VAG_LANES];           // Per sample position, then per lane
+    int lane_stream[VAG_LANES];            // Stream decoded by each lane (-1 = idle)
+    u_int lane_block[VAG_LANES];
+    __m128i tile[8];
+    VagVec s1, s2, c_lo, c_hi, r_lo, r_hi, p_lo, p_hi, k, one;
+    const u_char* block;
+    VagStream* stream;
+    int next = 0;
+    int active = 0;
+    int refill = 1;
+    int shift, filter;
+    int l, i, t, g;
+    
+    // Each lane takes the next stream as soon as its own one ends, so lanes
+    // stay busy however different the stream lengths are
+    for (l = 0; l < VAG_LANES; l++) {
+        lane_stream[l] = -1;
+        hist1[l] = hist2[l] = 0;
+    }
+    k = VEC_UNPACKLO(VEC_SET1(64), VEC_SET1(32));
+    one = VEC_SET1(1);
+    s1 = s2 = VEC_SET1(0);
+    
+    while (1) {
+        if (refill) {
+            VEC_STORE(hist1, s1);
+            VEC_STORE(hist2, s2);
+            for (l = 0; l < VAG_LANES; l++) {
+                if (lane_stream[l] >= 0) continue;
+                while (next < count && streams[next].blocks == 0) next++;
+                if (next >= count) break;
+                
+                lane_stream[l] = next;
+                lane_block[l] = 0;
+                hist1[l] = (short)streams[next].state.s1;
+                hist2[l] = (short)streams[next].state.s2;
+                next++;
+                active++;
+            }
+            s1 = VEC_LOAD(hist1);
+            s2 = VEC_LOAD(hist2);
+            refill = 0;
+        }
+        if (active == 0) break;
+        
+        for (l = 0; l < VAG_LANES; l++) {
+            block = lane_stream[l] >= 0 ?
+                    streams[lane_stream[l]].data + lane_block[l] * VAG_BLOCK_SIZE : vag_silent_block;
+            vagBlockHeader(block, &shift, &filter);
+            pos[l] = (short)vag_filter_pos[filter];
+            neg[l] = (short)vag_filter_neg[filter];
+            vagUnpack(block, shift, raw[l]);
+        }
+        
+        // Lanes x samples -> samples x lanes, 8x8 at a time
+        for (g = 0; g < VAG_LANES; g += 8) {
+            for (t = 0; t < 32; t += 8) {
+                for (i = 0; i < 8; i++) tile[i] = _mm_loadu_si128((const __m128i*)(raw[g + i] + t));
+                transpose8x8(tile);
+                for (i = 0; i < 8; i++) _mm_storeu_si128((__m128i*)(column[t + i] + g), tile[i]);
+            }
+        }
+        
+        c_lo = VEC_UNPACKLO(VEC_LOAD(pos), VEC_LOAD(neg));
+        c_hi = VEC_UNPACKHI(VEC_LOAD(pos), VEC_LOAD(neg));
+        for (i = 0; i < VAG_BLOCK_SAMPLES; i++) {
+            r_lo = VEC_MADD(VEC_UNPACKLO(VEC_LOAD(column[i]), one), k);
+            r_hi = VEC_MADD(VEC_UNPACKHI(VEC_LOAD(column[i]), one), k);
+            p_lo = VEC_SRAI(VEC_ADD(VEC_MADD(VEC_UNPACKLO(s1, s2), c_lo), r_lo), 6);
+            p_hi = VEC_SRAI(VEC_ADD(VEC_MADD(VEC_UNPACKHI(s1, s2), c_hi), r_hi), 6);
+            s2 = s1;
+            s1 = VEC_PACKS(p_lo, p_hi);
+            VEC_STORE(column[i], s1);
+        }
+        
+        // Back to lanes x samples, straight into the streams
+        for (g = 0; g < VAG_LANES; g += 8) {
+            for (t = 0; t < 32; t += 8) {
+                for (i = 0; i < 8; i++) tile[i] = _mm_loadu_si128((const __m128i*)(column[t + i] + g));
+                transpose8x8(tile);
+                for (i = 0; i < 8; i++) {
+                    l = g + i;
+                    if (lane_stream[l] < 0) continue;
+                    stream = &streams[lane_stream[l]];
+                    if (t < 24) {
+                        _mm_storeu_si128((__m128i*)(stream->out + lane_block[l] * VAG_BLOCK_SAMPLES + t), tile[i]);
+                    } else {
+                        _mm_storel_epi64((__m128i*)(stream->out + lane_block[l] * VAG_BLOCK_SAMPLES + t), tile[i]);
+                    }
+                }
+            }
+        }
+        
+        // Streams that ended keep their history and free the lane
+        for (l = 0; l < VAG_LANES; l++) {
+            if (lane_stream[l] < 0) continue;
+            stream = &streams[lane_stream[l]];
+            if (++lane_block[l] < stream->blocks) continue;
+            
+            stream->state.s1 = column[VAG_BLOCK_SAMPLES - 1][l];
+            stream->state.s2 = column[VAG_BLOCK_SAMPLES - 2][l];
+            lane_stream[l] = -1;
+            active--;
+            refill = 1;
+        }
+    }
+}
+#endif
+
+void vagDecodeStreams(VagStream* streams, int count)
+{
+    u_int b;
+    int i;
+    
+#if VAG_LANES > 1
+    // A single stream gains nothing from the vector path
+    if (count > 1) {
+        vagDecodeLanes(streams, count);
+        return;
+    }
+#endif
+    
+    for (i = 0; i < count; i++) {
+        for (b = 0; b < streams[i].blocks; b++) {
+            vagDecodeBlock(streams[i].data + b * VAG_BLOCK_SIZE,
+                           streams[i].out + b * VAG_BLOCK_SAMPLES, &streams[i].state);
+        }
+    }
+}
+
+const char* vagDecoderName(void)
+{
+    return VAG_SIMD;
+}
+
+u_int vagScan(const u_char* data, u_int size, int* loop_start, int* loops)
+{
+    u_int blocks = 0;
+    
+    *loop_start = -1;
+    *loops = 0;
+    
+    while ((blocks + 1) * VAG_BLOCK_SIZE <= size) {
+        const u_char* block = data + blocks * VAG_BLOCK_SIZE;
+        
+        if (block[1] & VAG_FLAG_LOOP_START) {
+            *loop_start = blocks * VAG_BLOCK_SAMPLES;
+        }
+        blocks++;
+        
+        if (block[1] & VAG_FLAG_END) {
+            *loops = (block[1] & VAG_FLAG_REPEAT) != 0;
+            break;
+        }
+    }
+    
+    return blocks;
+}
+
+int vagDecode(const u_char* data, u_int size, short* out, int* loop_start, int* loops)
+{
+    VagStream stream;
+    
+    stream.data = data;
+    stream.blocks = vagScan(data, size, loop_start, loops);
+    stream.out = out;
+    stream.state.s1 = 0;
+    stream.state.s2 = 0;
+    vagDecodeStreams(&stream, 1);
+    
+    return stream.blocks * VAG_BLOCK_SAMPLES;
+}
@@ -0,0 +1,50 @@
+// VAG ADPCM decoding
+// SPU samples are stored as 16-byte blocks: a shift/filter byte, a flag byte
+// and 14 bytes of 4-bit samples (28 samples per block).
+
+#ifndef VAG_H
+#define VAG_H
+
+#define VAG_BLOCK_SIZE 16
+#define VAG_BLOCK_SAMPLES 28
+
+// Block flags
+#define VAG_FLAG_END 0x01          // Last block: jump to the repeat address or stop
+#define VAG_FLAG_REPEAT 0x02       // With END: loop instead of stopping
+#define VAG_FLAG_LOOP_START 0x04   // Block becomes the repeat address
+
+// Filter history carried from one block to the next
+typedef struct {
+    int s1;                  // Previous sample
+    int s2;                  // Sample before that
+} VagState;
+
+// One sample stream for vagDecodeStreams (history starts at state)
+typedef struct {
+    const u_char* data;
+    u_int blocks;
+    short* out;              // blocks * 28 samples
+    VagState state;
+} VagStream;
+
+// Decode one block into 28 samples, exactly like the SPU
+void vagDecodeBlock(const u_char* block, short* out, VagState* state);
+
+// Decode independent streams (e.g. the VAGs of a VB). Each output sample
+// depends on the previous two, so a single stream is serial; the AVX2/SSE2
+// builds run 16/8 streams side by side in vector lanes instead. Output is
+// identical to vagDecodeBlock in every build
+void vagDecodeStreams(VagStream* streams, int count);
+
+// Name of the instruction set vagDecodeStreams was built for
+const char* vagDecoderName(void);
+
+// Blocks to decode from size bytes: up to and including the first END block.
+// loop_start is the first sample of the last LOOP_START block (-1 if none)
+// and loops is set when the end block has the REPEAT flag
+u_int vagScan(const u_char* data, u_int size, int* loop_start, int* loops);
+
+// vagScan + decode into out. Returns the number of samples written
+int vagDecode(const u_char* data, u_int size, short* out, int* loop_start, int* loops);
+
+#endif // VAG_H
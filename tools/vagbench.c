@@ -0,0 +1,195 @@
+// vagbench - VAG ADPCM decoder throughput and bit-exactness check
+//
+// Usage: vagbench file.vb...
+//
+// Each VB is split into its VAGs (a VAG ends with an END block) and decoded
+// with the one-block reference decoder and with vagDecodeStreams (AVX2/SSE2
+// when built for them). Both must give the same samples; the MB/s of ADPCM
+// input is reported for each. Random blocks with every shift/filter byte and
+// random history are checked first.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include "vag.h"
+#include "vab.h"
+
+#define BENCH_SECONDS 0.25          // Minimum time per measurement
+#define RANDOM_STREAMS 4096
+#define RANDOM_BLOCKS 64            // Blocks per random stream
+
+static double now(void)
+{
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void decodeReference(VagStream* streams, int count)
+{
+    u_int b;
+    int i;
+    
+    for (i = 0; i < count; i++) {
+        for (b = 0; b < streams[i].blocks; b++) {
+            vagDecodeBlock(streams[i].data + b * VAG_BLOCK_SIZE,
+                           streams[i].out + b * VAG_BLOCK_SAMPLES, &streams[i].state);
+        }
+    }
+}
+
+// Split data into VAG streams writing to out. Returns the number of streams
+static int splitStreams(const u_char* data, u_int size, short* out, VagStream* streams)
+{
+    u_int offset = 0;
+    int count = 0;
+    int loop_start, loops;
+    
+    while (offset + VAG_BLOCK_SIZE <= size) {
+        streams[count].data = data + offset;
+        streams[count].blocks = vagScan(data + offset, size - offset, &loop_start, &loops);
+        streams[count].out = out;
+        streams[count].state.s1 = 0;
+        streams[count].state.s2 = 0;
+        offset += streams[count].blocks * VAG_BLOCK_SIZE;
+        out += streams[count].blocks * VAG_BLOCK_SAMPLES;
+        count++;
+    }
+    return count;
+}
+
+static void resetStreams(VagStream* streams, int count)
+{
+    int i;
+    
+    for (i = 0; i < count; i++) {
+        streams[i].state.s1 = 0;
+        streams[i].state.s2 = 0;
+    }
+}
+
+// MB/s of ADPCM data decoded
+static double measure(void (*decode)(VagStream*, int), VagStream* streams, int count, u_int bytes)
+{
+    double start = now();
+    double elapsed;
+    u_long passes = 0;
+    
+    do {
+        resetStreams(streams, count);
+        decode(streams, count);
+        passes++;
+        elapsed = now() - start;
+    } while (elapsed < BENCH_SECONDS);
+    
+    return (double)passes * bytes / elapsed / 1e6;
+}
+
+// Decode data both ways and compare. Returns 0 if identical
+static int compare(const u_char* data, u_int size, VagStream* streams, short* expect, short* got, int* count)
+{
+    u_int samples = size / VAG_BLOCK_SIZE * VAG_BLOCK_SAMPLES;
+    int i;
+    
+    *count = splitStreams(data, size, expect, streams);
+    decodeReference(streams, *count);
+    splitStreams(data, size, got, streams);
+    vagDecodeStreams(streams, *count);
+    
+    if (memcmp(expect, got, samples * sizeof(short)) == 0) return 0;
+    for (i = 0; expect[i] == got[i]; i++);
+    printf("sample %d (block %d): expected %d, got %d\n", i, i / VAG_BLOCK_SAMPLES, expect[i], got[i]);
+    return -1;
+}
+
+static int checkRandom(void)
+{
+    u_int size = RANDOM_STREAMS * RANDOM_BLOCKS * VAG_BLOCK_SIZE;
+    u_int samples = RANDOM_STREAMS * RANDOM_BLOCKS * VAG_BLOCK_SAMPLES;
+    u_char* data = malloc(size);
+    short* expect = malloc(samples * sizeof(short));
+    short* got = malloc(samples * sizeof(short));
+    VagStream* streams = malloc(RANDOM_STREAMS * sizeof(VagStream));
+    u_int seed = 1;
+    u_int i;
+    int count, result;
+    
+    if (!data || !expect || !got || !streams) return -1;
+    
+    // Random nibbles, every shift/filter byte, and an END block closing each
+    // stream so the VB splitting gives RANDOM_STREAMS streams
+    for (i = 0; i < size; i++) {
+        seed = seed * 1103515245 + 12345;
+        data[i] = (u_char)(seed >> 16);
+    }
+    for (i = 0; i < size / VAG_BLOCK_SIZE; i++) {
+        data[i * VAG_BLOCK_SIZE] = (u_char)i;
+        data[i * VAG_BLOCK_SIZE + 1] = (i % RANDOM_BLOCKS == RANDOM_BLOCKS - 1) ? VAG_FLAG_END : 0;
+    }
+    
+    result = compare(data, size, streams, expect, got, &count);
+    printf("%d random streams: %s %s scalar\n", count, vagDecoderName(),
+           result == 0 ? "matches" : "DIFFERS from");
+    
+    free(data);
+    free(expect);
+    free(got);
+    free(streams);
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    VagStream* streams;
+    u_char* data;
+    short* expect;
+    short* got;
+    u_int size;
+    double scalar, simd;
+    int failed = 0;
+    int i, count;
+    
+    if (argc < 2) {
+        fprintf(stderr, "usage: vagbench file.vb...\n");
+        return 2;
+    }
+    
+    if (checkRandom() < 0) failed = 1;
+    
+    for (i = 1; i < argc; i++) {
+        data = loadFile(argv[i], &size);
+        if (!data) {
+            fprintf(stderr, "%s: cannot read\n", argv[i]);
+            failed = 1;
+            continue;
+        }
+        
+        streams = malloc((size / VAG_BLOCK_SIZE + 1) * sizeof(VagStream));
+        expect = malloc((size / VAG_BLOCK_SIZE + 1) * VAG_BLOCK_SAMPLES * sizeof(short));
+        got = malloc((size / VAG_BLOCK_SIZE + 1) * VAG_BLOCK_SAMPLES * sizeof(short));
+        if (!streams || !expect || !got) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+        
+        if (compare(data, size, streams, expect, got, &count) < 0) {
+            printf("%s: %s output differs from scalar\n", argv[i], vagDecoderName());
+            failed = 1;
+        } else {
+            scalar = measure(decodeReference, streams, count, size);
+            simd = measure(vagDecodeStreams, streams, count, size);
+            printf("%s: %u bytes, %d VAGs, scalar %.1f MB/s, %s %.1f MB/s (%.2fx)\n", argv[i], size,
+                   count, scalar, vagDecoderName(), simd, simd / scalar);
+        }
+        
+        free(streams);
+        free(expect);
+        free(got);
+        free(data);
+    }
+    
+    return failed;
+}
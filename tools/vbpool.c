@@ -0,0 +1,209 @@
+// vbpool - build-time VAG deduplication for the player (VB_POOL=1 in the Makefile)
+//
+// Usage: vbpool pool.vb vbpool.h bank.vh bank.vb [bank.vh bank.vb ...]
+//
+// Every VAG of every VB is stored once in pool.vb, which the player uploads to
+// SPU RAM at startup. vbpool.h lists where each bank's VAGs are in the pool, so
+// a bank is opened by pointing its VAG addresses into the pool instead of
+// uploading its VB. Banks from the same game often share samples.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include "vab.h"
+
+// VH layout
+#define VH_HEADER_SIZE 32
+#define VH_PROG_SIZE 16
+#define VH_TONE_SIZE 32
+
+// SPU RAM the player's soundbank cache can use (SPU_RAM_END - SPU_RAM_BASE)
+#define POOL_MAX (0x80000 - 0x18040 - 0x1010)
+
+#define LE16(p) ((p)[0] | ((p)[1] << 8))
+
+#define POOL_BUCKETS 4096     // Hash chains of the unique VAGs (power of two)
+
+// Unique sample in the pool
+typedef struct {
+    const u_char* data;
+    u_int size;
+    u_int offset;            // In the pool
+    u_int hash;              // FNV-1a of the data
+    int next;                // Next VAG in the same hash chain, -1 at the end
+} PoolVag;
+
+static u_int vagHash(const u_char* data, u_int size)
+{
+    u_int hash = 0x811C9DC5;
+    u_int i;
+    
+    for (i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 0x01000193;
+    }
+    return hash;
+}
+
+// Drop both outputs of a failed run, so make does not take them as up to date
+static int fail(FILE* pool, FILE* header, char** argv)
+{
+    fclose(pool);
+    fclose(header);
+    remove(argv[1]);
+    remove(argv[2]);
+    return 1;
+}
+
+// Name used for the bank's table in vbpool.h (file name, non-alphanumerics as _)
+static void symbolName(char* out, int size, const char* path)
+{
+    const char* slash = strrchr(path, '/');
+    int i;
+    
+    snprintf(out, size, "%s", slash ? slash + 1 : path);
+    for (i = 0; out[i]; i++) {
+        if (!((out[i] >= 'a' && out[i] <= 'z') || (out[i] >= 'A' && out[i] <= 'Z') ||
+              (out[i] >= '0' && out[i] <= '9'))) {
+            out[i] = '_';
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    PoolVag* vags = NULL;
+    int buckets[POOL_BUCKETS];
+    int num_vags = 0;
+    u_int pool_size = 0, input_size = 0;
+    u_char* vh;
+    u_char* vb;
+    u_int vh_size, vb_size, offset, vag_size;
+    const u_char* sizes;
+    u_int hash;
+    char name[256];
+    FILE* pool;
+    FILE* header;
+    int bank, num_banks, ps, vs, i, j;
+    
+    if (argc < 5 || (argc - 3) % 2 != 0) {
+        fprintf(stderr, "usage: vbpool pool.vb vbpool.h bank.vh bank.vb [bank.vh bank.vb ...]\n");
+        return 1;
+    }
+    num_banks = (argc - 3) / 2;
+    for (i = 0; i < POOL_BUCKETS; i++) {
+        buckets[i] = -1;
+    }
+    
+    pool = fopen(argv[1], "wb");
+    header = fopen(argv[2], "w");
+    if (!pool || !header) {
+        fprintf(stderr, "%s: cannot write\n", pool ? argv[2] : argv[1]);
+        if (pool) fclose(pool);
+        if (header) fclose(header);
+        remove(argv[1]);
+        remove(argv[2]);
+        return 1;
+    }
+    
+    fprintf(header, "// Auto-generated by tools/vbpool - do not edit manually\n\n");
+    fprintf(header, "#ifndef VBPOOL_H\n#define VBPOOL_H\n\n");
+    
+    for (bank = 0; bank < num_banks; bank++) {
+        const char* vh_path = argv[3 + bank * 2];
+        const char* vb_path = argv[4 + bank * 2];
+    
+        vh = loadFile(vh_path, &vh_size);
+        vb = loadFile(vb_path, &vb_size);
+        if (!vh || !vb) {
+            fprintf(stderr, "%s: cannot read\n", vh ? vb_path : vh_path);
+            return fail(pool, header, argv);
+        }
+        ps = LE16(vh + 18);
+        vs = LE16(vh + 22);
+        sizes = vh + VH_HEADER_SIZE + VAB_MAX_PROGRAMS * VH_PROG_SIZE + ps * VAB_MAX_TONES * VH_TONE_SIZE;
+        if (vh_size < VH_HEADER_SIZE || memcmp(vh, "pBAV", 4) != 0 || vs >= VAB_MAX_VAGS ||
+            sizes + VAB_MAX_VAGS * 2 > vh + vh_size) {
+            fprintf(stderr, "%s: not a valid VH\n", vh_path);
+            return fail(pool, header, argv);
+        }
+    
+        // VAG sizes are stored / 8, entry 0 is unused. The VBs stay loaded
+        // since the pool points into them until it is written
+        symbolName(name, sizeof(name), vh_path);
+        fprintf(header, "static const u_long vb_pool_%s[] = {", name);
+        offset = 0;
+        for (i = 1; i <= vs; i++) {
+            vag_size = LE16(sizes + i * 2) << 3;
+            if (offset + vag_size > vb_size) {
+                fprintf(stderr, "%s: VAG %d is past the end of %s\n", vh_path, i, vb_path);
+                return fail(pool, header, argv);
+            }
+    
+            // Only VAGs with the same hash are compared byte for byte
+            hash = vagHash(vb + offset, vag_size);
+            for (j = buckets[hash & (POOL_BUCKETS - 1)]; j >= 0; j = vags[j].next) {
+                if (vags[j].hash == hash && vags[j].size == vag_size &&
+                    memcmp(vags[j].data, vb + offset, vag_size) == 0) {
+                    break;
+                }
+            }
+            if (j < 0) {
+                vags = realloc(vags, (num_vags + 1) * sizeof(PoolVag));
+                if (!vags) {
+                    fprintf(stderr, "out of memory\n");
+                    return fail(pool, header, argv);
+                }
+                j = num_vags++;
+                vags[j].data = vb + offset;
+                vags[j].size = vag_size;
+                vags[j].offset = pool_size;
+                vags[j].hash = hash;
+                vags[j].next = buckets[hash & (POOL_BUCKETS - 1)];
+                buckets[hash & (POOL_BUCKETS - 1)] = j;
+                pool_size += vag_size;
+            }
+    
+            fprintf(header, "%s0x%x", (i - 1) % 8 ? ", " : "\n    ", vags[j].offset);
+            offset += vag_size;
+        }
+        fprintf(header, "%s};\n", vs ? "\n" : " 0 ");
+        input_size += vb_size;
+        free(vh);
+    }
+    
+    printf("vbpool: %d banks, %u bytes of VB -> %u bytes (%d unique VAGs)\n", num_banks, input_size,
+           pool_size, num_vags);
+    if (pool_size > POOL_MAX) {
+        fprintf(stderr, "vbpool: %u bytes do not fit in SPU RAM (%u), build with VB_POOL=0\n", pool_size,
+                (u_int)POOL_MAX);
+        return fail(pool, header, argv);
+    }
+    
+    for (i = 0; i < num_vags; i++) {
+        fwrite(vags[i].data, 1, vags[i].size, pool);
+    }
+    
+    // Bank table: VH file name, VAG count, offset of each VAG (VAG number - 1)
+    fprintf(header, "\n#define VB_POOL_SIZE 0x%x\n", pool_size);
+    fprintf(header, "#define VB_POOL_BANKS { \\\n");
+    for (bank = 0; bank < num_banks; bank++) {
+        const char* vh_path = argv[3 + bank * 2];
+        const char* slash = strrchr(vh_path, '/');
+    
+        vh = loadFile(vh_path, &vh_size);
+        symbolName(name, sizeof(name), vh_path);
+        fprintf(header, "    {\"%s\", %d, vb_pool_%s}, \\\n", slash ? slash + 1 : vh_path, LE16(vh + 22), name);
+        free(vh);
+    }
+    fprintf(header, "}\n\n#endif // VBPOOL_H\n");
+    
+    if (fclose(pool) != 0 || fclose(header) != 0) {
+        fprintf(stderr, "%s: cannot write\n", argv[1]);
+        remove(argv[1]);
+        remove(argv[2]);
+        return 1;
+    }
+    return 0;
+}